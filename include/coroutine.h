@@ -42,7 +42,7 @@ public:
         Stopped,
         Joined,
     };
-    explicit BaseCoroutine(BaseCoroutine * previous, size_t stackSize = 1024 * 1024 * 8);
+    explicit BaseCoroutine(BaseCoroutine * previous, size_t stackSize = defaultStackSize());
     virtual ~BaseCoroutine();
 
     virtual void run();
@@ -54,8 +54,12 @@ public:
 
     BaseCoroutine *previous() const;
     void setPrevious(BaseCoroutine *previous);
+    size_t stackSize() const;
+    size_t peakStackUsage() const;
 
     static BaseCoroutine *current();
+    static size_t defaultStackSize();
+    static void setDefaultStackSize(size_t stackSize);
 public:
     Deferred<BaseCoroutine*> started;
     Deferred<BaseCoroutine*> finished;
@@ -68,6 +72,18 @@ private:
     Q_DECLARE_PRIVATE(BaseCoroutine)
 };
 
+// stacks of finished coroutines are kept by each thread, and reused by new coroutines.
+class CoroutineStackPool
+{
+public:
+    static void setSizeClasses(const QList<size_t> &sizeClasses);
+    static QList<size_t> sizeClasses();
+    static void setHighWaterMark(int stacks);
+    static int highWaterMark();
+    static int cachedStacks();
+    static void clear();
+};
+
 inline QDebug &operator <<(QDebug &out, const BaseCoroutine& coroutine)
 {
     if(coroutine.objectName().isEmpty()) {
@@ -29,6 +29,12 @@ protected:
 
 BaseCoroutine* createMainCoroutine();
 
+// the stack is taken from the pool of current thread, and `stackSize` is rounded up to its size class.
+void *allocateCoroutineStack(size_t *stackSize);
+void releaseCoroutineStack(void *stack, size_t stackSize);
+// returns the bytes ever written from the top of stack.
+size_t coroutineStackUsage(void *stack, size_t stackSize);
+
 // 开始声明 CurrentCoroutineStorage
 
 class CurrentCoroutineStorage
@@ -0,0 +1,49 @@
+#ifndef QTNG_DNS_H
+#define QTNG_DNS_H
+
+#include <QtCore/qstring.h>
+#include <QtCore/qstringlist.h>
+#include <QtCore/qlist.h>
+#include <QtNetwork/qhostaddress.h>
+#include "config.h"
+
+QTNETWORKNG_NAMESPACE_BEGIN
+
+class DnsResolverPrivate;
+class DnsResolver
+{
+public:
+    enum RecordType {
+        A = 1,
+        AAAA = 28,
+    };
+public:
+    DnsResolver();
+    virtual ~DnsResolver();
+public:
+    QList<QHostAddress> resolve(const QString &hostName, quint32 *ttl = 0);
+    QList<QHostAddress> query(const QString &hostName, RecordType type, quint32 *ttl = 0);
+
+    bool loadResolvConf(const QString &filePath = QStringLiteral("/etc/resolv.conf"));
+    bool loadHosts(const QString &filePath = QStringLiteral("/etc/hosts"));
+    void addHost(const QString &hostName, const QHostAddress &address);
+    void clearHosts();
+
+    void setNameServers(const QList<QHostAddress> &nameServers, quint16 port = 53);
+    QList<QHostAddress> nameServers() const;
+    quint16 nameServerPort() const;
+    void setSearchDomains(const QStringList &searchDomains);
+    QStringList searchDomains() const;
+    void setTimeout(int msecs);
+    int timeout() const;
+    void setAttempts(int attempts);
+    int attempts() const;
+private:
+    DnsResolverPrivate * const d_ptr;
+    Q_DECLARE_PRIVATE(DnsResolver)
+    Q_DISABLE_COPY(DnsResolver)
+};
+
+QTNETWORKNG_NAMESPACE_END
+
+#endif // QTNG_DNS_H
@@ -98,13 +98,32 @@ private:
     int watcherId;
 };
 
+// a long-lived watcher, armed only while a coroutine waits for the fd.
+class PersistentIoWatcher
+{
+public:
+    explicit PersistentIoWatcher(EventLoopCoroutine::EventType event);
+    ~PersistentIoWatcher();
+    void wait(qintptr fd);
+    void reset();
+private:
+    EventLoopCoroutine::EventType event;
+    QPointer<EventLoopCoroutine> eventLoop;
+    YieldCurrentFunctor *functor;
+    int watcherId;
+    qintptr fd;
+    bool waiting;
+    bool resetPending;
+    Q_DISABLE_COPY(PersistentIoWatcher)
+};
+
 class CoroutinePrivate;
 class Coroutine: public BaseCoroutine
 {
     Q_DISABLE_COPY(Coroutine)
 public:
-    explicit Coroutine(size_t stackSize = 1024 * 1024 * 8);
-    Coroutine(QObject *obj, const char *slot, size_t stackSize = 1024 * 1024 * 8);
+    explicit Coroutine(size_t stackSize = BaseCoroutine::defaultStackSize());
+    Coroutine(QObject *obj, const char *slot, size_t stackSize = BaseCoroutine::defaultStackSize());
     virtual ~Coroutine();
 public:
     bool isRunning() const;
@@ -0,0 +1,102 @@
+#ifndef QTNG_EVENTLOOP_P_H
+#define QTNG_EVENTLOOP_P_H
+
+#include <QtCore/qvector.h>
+#include <QtCore/qatomic.h>
+#include "eventloop.h"
+
+QTNETWORKNG_NAMESPACE_BEGIN
+
+// a hierarchical timing wheel shared by the event loop backends. arming and cancelling a timer is O(1),
+// timers due in the same tick fire in one pass, and nodes are recycled without allocation.
+class TimerWheel
+{
+public:
+    explicit TimerWheel(int tickMsecs = 1);
+    ~TimerWheel();
+public:
+    int add(int msecs, int interval, Functor *callback);
+    void cancel(int timerId);
+    qint64 nextTimeout() const;
+    void expire();
+    int size() const { return count; }
+    static qint64 now();
+private:
+    struct Node
+    {
+        Functor *callback;
+        qint64 expires;
+        qint64 interval;
+        int id;
+        int prev;
+        int next;
+        int slot;
+        quint16 firing;
+        bool released;
+    };
+    enum {
+        LevelBits = 8,
+        SlotsPerLevel = 1 << LevelBits,
+        SlotMask = SlotsPerLevel - 1,
+        Levels = 4,
+        DueSlot = Levels * SlotsPerLevel,
+        FiringSlot = DueSlot + 1,
+        SlotCount = FiringSlot + 1,
+        IndexBits = 20,
+        IndexMask = (1 << IndexBits) - 1,
+        GenerationMask = (1 << (31 - IndexBits)) - 1,
+        MinFreeNodes = 1024,
+    };
+    int allocate();
+    void free(int index);
+    void link(int index);
+    void unlink(int index);
+    void cascade(int level);
+    void run(int slot);
+    int findSlot(int level, int from) const;
+    bool isOccupied(int slot) const { return heads.at(slot) >= 0; }
+    Node *get(int timerId);
+private:
+    QVector<Node> nodes;
+    QVector<int> heads;
+    QVector<quint64> bitmap;
+    qint64 currentTick;
+    int tickMsecs;
+    int freeHead;
+    int freeTail;
+    int freeCount;
+    int count;
+    bool processing;
+};
+
+
+// a lock-free multi-producer single-consumer queue for callLaterThreadSafe(). any thread may push,
+// only the event loop drains it.
+class CallLaterQueue
+{
+public:
+    CallLaterQueue();
+    ~CallLaterQueue();
+public:
+    bool push(int msecs, Functor *callback);
+    bool drain(EventLoopCoroutinePrivate *loop, int maxItems = 1024);
+private:
+    struct Item
+    {
+        QAtomicPointer<Item> next;
+        Functor *callback;
+        int msecs;
+    };
+    void pushItem(Item *item);
+    Item *pop();
+private:
+    QAtomicPointer<Item> head;
+    Item *tail;
+    Item stub;
+    QAtomicInt wakeup;
+    Q_DISABLE_COPY(CallLaterQueue)
+};
+
+QTNETWORKNG_NAMESPACE_END
+
+#endif // QTNG_EVENTLOOP_P_H
@@ -177,6 +177,8 @@ public:
 
     void setMaxConnectionsPerServer(int maxConnectionsPerServer);
     int maxConnectionsPerServer();
+    void setTcpFastOpen(bool enabled);
+    bool tcpFastOpen() const;
 
     void setDebugLevel(int level);
     void disableDebug();
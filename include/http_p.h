@@ -12,11 +12,19 @@ QTNETWORKNG_NAMESPACE_BEGIN
 
 class HttpProxy;
 class Socks5Proxy;
+class SslSessionCache;
+struct IdleConnection
+{
+    QSharedPointer<SocketLike> connection;
+    QDateTime lastUsed;
+};
+
+
 struct ConnectionPoolItem
 {
     QDateTime lastUsed;
     QSharedPointer<Semaphore> semaphore;
-    QSet<QSharedPointer<SocketLike>> connections;
+    QList<IdleConnection> connections;
 };
 
 
@@ -27,6 +35,8 @@ public:
     virtual ~ConnectionPool();
     void recycle(const QUrl &url, QSharedPointer<SocketLike> connection);
     QSharedPointer<SocketLike> connectionForUrl(const QUrl &url);
+    QSharedPointer<SocketLike> takeIdleConnection(const QUrl &url);
+    QSharedPointer<SocketLike> newConnectionForUrl(const QUrl &url, const QByteArray &firstBytes = QByteArray(), bool *firstBytesSent = 0);
     void removeUnusedConnections();
     QSharedPointer<Socks5Proxy> socks5Proxy() const;
     QSharedPointer<HttpProxy> httpProxy() const;
@@ -36,9 +46,11 @@ public:
     QMap<QUrl, ConnectionPoolItem> items;
     int maxConnectionsPerServer;
     int timeToLive;
+    bool tcpFastOpen;
     QSharedPointer<SocketDnsCache> dnsCache;
     CoroutineGroup *operations;
     QSharedPointer<BaseProxySwitcher> proxySwitcher;
+    QSharedPointer<SslSessionCache> sslSessionCache;
 };
 
 
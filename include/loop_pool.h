@@ -0,0 +1,215 @@
+#ifndef QTNG_LOOP_POOL_H
+#define QTNG_LOOP_POOL_H
+
+#include <functional>
+#include <QtCore/qqueue.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qdebug.h>
+#include <QtCore/qsharedpointer.h>
+#include "eventloop.h"
+#include "socket.h"
+
+QTNETWORKNG_NAMESPACE_BEGIN
+
+class LoopPoolPrivate;
+class LoopPool
+{
+public:
+    enum PlacementPolicy {
+        RoundRobin,
+        LeastLoaded,
+    };
+public:
+    explicit LoopPool(int size = 0);
+    virtual ~LoopPool();
+public:
+    int size() const;
+    EventLoopCoroutine *loop(int index) const;
+    int load(int index) const;
+    int indexOf(EventLoopCoroutine *loop) const;
+    void setPlacementPolicy(PlacementPolicy policy);
+    PlacementPolicy placementPolicy() const;
+    int spawn(const std::function<void()> &func);
+    bool spawnOn(int index, const std::function<void()> &func);
+    bool spawnOn(EventLoopCoroutine *loop, const std::function<void()> &func);
+    void stop();
+private:
+    LoopPoolPrivate * const d_ptr;
+    Q_DECLARE_PRIVATE(LoopPool)
+    Q_DISABLE_COPY(LoopPool)
+};
+
+
+// listen on the same port in every loop of the pool with SO_REUSEPORT. the kernel spreads incoming connections
+// over the sockets, and every connection is handled in the thread which accepted it.
+class ReusePortServerPrivate;
+class ReusePortServer
+{
+public:
+    ReusePortServer(LoopPool *pool, const QHostAddress &address, quint16 port = 0);
+    virtual ~ReusePortServer();
+public:
+    void setHandler(const std::function<void(QSharedPointer<Socket>)> &handler);
+    bool start(int backlog = 128);
+    void stop();
+    bool isRunning() const;
+    int shards() const;
+    quint16 serverPort() const;
+    Socket::SocketError error() const;
+    QString errorString() const;
+private:
+    ReusePortServerPrivate * const d_ptr;
+    Q_DECLARE_PRIVATE(ReusePortServer)
+    Q_DISABLE_COPY(ReusePortServer)
+};
+
+
+// unlike Event, ThreadEvent can be set from any thread, and the coroutines waiting in different event loops are waked up by their own loops.
+class ThreadEventPrivate;
+class ThreadEvent
+{
+public:
+    ThreadEvent();
+    virtual ~ThreadEvent();
+public:
+    bool wait(bool blocking = true);
+    void set();
+    void clear();
+    bool isSet() const;
+    int getting() const;
+private:
+    ThreadEventPrivate * const d_ptr;
+    Q_DECLARE_PRIVATE(ThreadEvent)
+    Q_DISABLE_COPY(ThreadEvent)
+};
+
+
+template <typename T>
+class ThreadQueue
+{
+public:
+    ThreadQueue(int capacity);
+    ~ThreadQueue();
+    void setCapacity(int capacity);
+    bool put(const T &e);
+    T get();
+    bool isEmpty() const;
+    bool isFull() const;
+    int getCapacity() const;
+    int size() const;
+    int getting() const { return notEmpty.getting(); }
+private:
+    bool isFullLocked() const { return capacity > 0 && queue.size() >= capacity; }
+private:
+    QQueue<T> queue;
+    mutable QMutex mutex;
+    ThreadEvent notEmpty;
+    ThreadEvent notFull;
+    int capacity;
+    Q_DISABLE_COPY(ThreadQueue)
+};
+
+template<typename T>
+ThreadQueue<T>::ThreadQueue(int capacity)
+    :capacity(capacity)
+{
+    notEmpty.clear();
+    notFull.set();
+}
+
+template<typename T>
+ThreadQueue<T>::~ThreadQueue()
+{
+    if(queue.size() > 0) {
+        qDebug() << "queue is free with element left.";
+    }
+}
+
+template<typename T>
+void ThreadQueue<T>::setCapacity(int capacity)
+{
+    QMutexLocker locker(&mutex);
+    this->capacity = capacity;
+    if(isFullLocked()) {
+        notFull.clear();
+    } else {
+        notFull.set();
+    }
+}
+
+// the events are only hints, the queue is checked again with the mutex held after every wakeup.
+template<typename T>
+bool ThreadQueue<T>::put(const T &e)
+{
+    while(true) {
+        {
+            QMutexLocker locker(&mutex);
+            if(!isFullLocked()) {
+                queue.enqueue(e);
+                notEmpty.set();
+                if(isFullLocked()) {
+                    notFull.clear();
+                }
+                return true;
+            }
+        }
+        if(!notFull.wait()) {
+            return false;
+        }
+    }
+}
+
+template<typename T>
+T ThreadQueue<T>::get()
+{
+    while(true) {
+        {
+            QMutexLocker locker(&mutex);
+            if(!queue.isEmpty()) {
+                const T e = queue.dequeue();
+                if(queue.isEmpty()) {
+                    notEmpty.clear();
+                }
+                if(!isFullLocked()) {
+                    notFull.set();
+                }
+                return e;
+            }
+        }
+        if(!notEmpty.wait()) {
+            return T();
+        }
+    }
+}
+
+template<typename T>
+bool ThreadQueue<T>::isEmpty() const
+{
+    QMutexLocker locker(&mutex);
+    return queue.isEmpty();
+}
+
+template<typename T>
+bool ThreadQueue<T>::isFull() const
+{
+    QMutexLocker locker(&mutex);
+    return isFullLocked();
+}
+
+template<typename T>
+int ThreadQueue<T>::getCapacity() const
+{
+    QMutexLocker locker(&mutex);
+    return capacity;
+}
+
+template<typename T>
+int ThreadQueue<T>::size() const
+{
+    QMutexLocker locker(&mutex);
+    return queue.size();
+}
+
+QTNETWORKNG_NAMESPACE_END
+
+#endif // QTNG_LOOP_POOL_H
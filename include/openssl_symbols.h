@@ -179,6 +179,12 @@ typedef int i2d_of_void (void *,unsigned char **);
 #define OPENSSL_VERSION_NUMBER 0x10000000L
 #define SHLIB_VERSION_NUMBER "1.0.0"
 #define SSL_CTRL_SET_TMP_ECDH 4
+#define SSL_CTRL_GET_SESSION_REUSED 8
+#define SSL_CTRL_SET_READ_AHEAD 41
+#define SSL_CTRL_SET_SESS_CACHE_SIZE 42
+#define SSL_CTRL_SET_SESS_CACHE_MODE 44
+#define SSL_SESS_CACHE_SERVER 0x0002
+#define SSL_OP_ENABLE_KTLS 0x00000008U
 #define NID_undef 0
 #define EVP_PKEY_RSA 6
 #define EVP_PKEY_DSA 116
@@ -223,6 +229,16 @@ typedef int i2d_of_void (void *,unsigned char **);
 
 #define BIO_CTRL_INFO 3
 #define BIO_CTRL_PENDING 10
+#define BIO_CTRL_FLUSH 11
+#define BIO_CTRL_GET_KTLS_SEND 73
+#define BIO_CTRL_GET_KTLS_RECV 76
+#define BIO_NOCLOSE 0x00
+#define BIO_TYPE_SOURCE_SINK 0x0400
+#define BIO_FLAGS_READ 0x01
+#define BIO_FLAGS_WRITE 0x02
+#define BIO_FLAGS_IO_SPECIAL 0x04
+#define BIO_FLAGS_RWS (BIO_FLAGS_READ | BIO_FLAGS_WRITE | BIO_FLAGS_IO_SPECIAL)
+#define BIO_FLAGS_SHOULD_RETRY 0x08
 
 #define SSL_ERROR_NONE 0
 #define SSL_ERROR_SSL 1
@@ -852,6 +868,27 @@ BIO_METHOD *q_BIO_s_mem();
 int q_BIO_read(BIO *a, void *b, int c);
 int q_BIO_write(BIO *a, const void *b, int c);
 int q_BIO_up_ref(BIO *a);
+// custom BIO methods, only available since openssl 1.1.0
+typedef int (*q_bio_write_t)(BIO *, const char *, int);
+typedef int (*q_bio_read_t)(BIO *, char *, int);
+typedef long (*q_bio_ctrl_t)(BIO *, int, long, void *);
+bool has_BIO_get_new_index();
+int q_BIO_get_new_index();
+BIO_METHOD *q_BIO_meth_new(int type, const char *name);
+int q_BIO_meth_set_write(BIO_METHOD *biom, q_bio_write_t write);
+int q_BIO_meth_set_read(BIO_METHOD *biom, q_bio_read_t read);
+int q_BIO_meth_set_ctrl(BIO_METHOD *biom, q_bio_ctrl_t ctrl);
+void q_BIO_set_data(BIO *a, void *ptr);
+void *q_BIO_get_data(BIO *a);
+void q_BIO_set_init(BIO *a, int init);
+void q_BIO_set_flags(BIO *a, int flags);
+void q_BIO_clear_flags(BIO *a, int flags);
+BIO *q_BIO_new_socket(int sock, int close_flag);
+#define q_BIO_get_ktls_send(b) q_BIO_ctrl((b), BIO_CTRL_GET_KTLS_SEND, 0, NULL)
+#define q_BIO_get_ktls_recv(b) q_BIO_ctrl((b), BIO_CTRL_GET_KTLS_RECV, 0, NULL)
+#define q_BIO_set_retry_read(b) q_BIO_set_flags((b), (BIO_FLAGS_READ | BIO_FLAGS_SHOULD_RETRY))
+#define q_BIO_set_retry_write(b) q_BIO_set_flags((b), (BIO_FLAGS_WRITE | BIO_FLAGS_SHOULD_RETRY))
+#define q_BIO_clear_retry_flags(b) q_BIO_clear_flags((b), (BIO_FLAGS_RWS | BIO_FLAGS_SHOULD_RETRY))
 
 const EC_GROUP* q_EC_KEY_get0_group(const EC_KEY* k);
 int q_EC_GROUP_get_degree(const EC_GROUP* g);
@@ -897,6 +934,7 @@ int q_SSL_CTX_set_cipher_list(SSL_CTX *a, const char *b);
 int q_SSL_CTX_set_default_verify_paths(SSL_CTX *a);
 void q_SSL_CTX_set_verify(SSL_CTX *a, int b, int (*c)(int, X509_STORE_CTX *));
 void q_SSL_CTX_set_verify_depth(SSL_CTX *a, int b);
+int q_SSL_CTX_set_session_id_context(SSL_CTX *a, const unsigned char *b, unsigned int c);
 int q_SSL_CTX_use_certificate(SSL_CTX *a, X509 *b);
 int q_SSL_CTX_use_certificate_file(SSL_CTX *a, const char *b, int c);
 int q_SSL_CTX_use_PrivateKey(SSL_CTX *a, EVP_PKEY *b);
@@ -923,6 +961,7 @@ void q_SSL_load_error_strings();
 SSL *q_SSL_new(SSL_CTX *a);
 long q_SSL_ctrl(SSL *ssl,int cmd, long larg, void *parg);
 int q_SSL_read(SSL *a, void *b, int c);
+int q_SSL_pending(const SSL *a);
 void q_SSL_set_bio(SSL *a, BIO *b, BIO *c);
 void q_SSL_set0_rbio(SSL *a, BIO *b);
 BIO *q_SSL_get_rbio(SSL *a);
@@ -931,6 +970,8 @@ BIO *q_SSL_get_wbio(SSL *a);
 void q_SSL_set_accept_state(SSL *a);
 void q_SSL_set_connect_state(SSL *a);
 int q_SSL_shutdown(SSL *a);
+// the options are uint64_t since openssl 3.0, and unsigned long before. call it with openssl 3.0 only.
+quint64 q_SSL_set_options(SSL *s, quint64 op);
 int q_SSL_set_session(SSL *to, SSL_SESSION *session);
 void q_SSL_SESSION_free(SSL_SESSION *ses);
 SSL_SESSION *q_SSL_get1_session(SSL *ssl);
@@ -998,6 +1039,10 @@ void q_PKCS12_free(PKCS12 *pkcs12);
 
 #define q_SSL_CTX_set_options(ctx,op) q_SSL_CTX_ctrl((ctx),SSL_CTRL_OPTIONS,(op),NULL)
 #define q_SSL_CTX_set_mode(ctx,op) q_SSL_CTX_ctrl((ctx),SSL_CTRL_MODE,(op),NULL)
+#define q_SSL_CTX_set_session_cache_mode(ctx,m) q_SSL_CTX_ctrl((ctx),SSL_CTRL_SET_SESS_CACHE_MODE,(m),NULL)
+#define q_SSL_CTX_sess_set_cache_size(ctx,t) q_SSL_CTX_ctrl((ctx),SSL_CTRL_SET_SESS_CACHE_SIZE,(t),NULL)
+#define q_SSL_session_reused(ssl) q_SSL_ctrl((ssl),SSL_CTRL_GET_SESSION_REUSED,0,NULL)
+#define q_SSL_set_read_ahead(ssl,yes) q_SSL_ctrl((ssl),SSL_CTRL_SET_READ_AHEAD,(yes),NULL)
 #define q_SKM_sk_num(type, st) ((int (*)(const STACK_OF(type) *))q_sk_num)(st)
 #define q_SKM_sk_value(type, st,i) ((type * (*)(const STACK_OF(type) *, int))q_sk_value)(st, i)
 #define q_sk_GENERAL_NAME_num(st) q_SKM_sk_num(GENERAL_NAME, (st))
@@ -1016,6 +1061,8 @@ void q_OPENSSL_add_all_algorithms_conf();
 int q_SSL_CTX_load_verify_locations(SSL_CTX *ctx, const char *CAfile, const char *CApath);
 long q_SSLeay();
 const char *q_SSLeay_version(int type);
+// SSLeay() is a macro of OpenSSL_version_num() since openssl 1.1.0.
+unsigned long q_OpenSSL_version_num();
 int q_i2d_SSL_SESSION(SSL_SESSION *in, unsigned char **pp);
 SSL_SESSION *q_d2i_SSL_SESSION(SSL_SESSION **a, const unsigned char **pp, long length);
 
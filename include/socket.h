@@ -4,6 +4,7 @@
 #include <QtCore/qstring.h>
 #include <QtCore/qbytearray.h>
 #include <QtCore/qobject.h>
+#include <QtCore/qfile.h>
 #include <QtNetwork/qhostaddress.h>
 #include <QtNetwork/qhostinfo.h>
 
@@ -38,6 +39,8 @@ QTNETWORKNG_NAMESPACE_BEGIN
 
 class SocketPrivate;
 class SocketDnsCache;
+class DnsResolver;
+class DatagramBatch;
 
 class Socket: public QObject
 {
@@ -109,7 +112,12 @@ public:
         ReceiveBufferSizeSocketOption,  //SO_RCVBUF
         MaxStreamsSocketOption, // for sctp
         NonBlockingSocketOption,
-        BindExclusively
+        BindExclusively,
+        ReusePortOption, // SO_REUSEPORT
+        UdpGsoOption, // UDP_SEGMENT for sendmany()
+        UdpGroOption, // UDP_GRO for recvmany()
+        TcpFastOpenOption, // TCP_FASTOPEN
+        DeferAcceptOption, // TCP_DEFER_ACCEPT
     };
     Q_ENUMS(SocketOption)
     enum BindFlag {
@@ -138,10 +146,13 @@ public:
     NetworkLayerProtocol protocol() const;
 
     Socket *accept();
+    QList<Socket*> acceptMany(int maxCount = 64);
     bool bind(QHostAddress &address, quint16 port = 0, BindMode mode = DefaultForPlatform);
     bool bind(quint16 port = 0, BindMode mode = DefaultForPlatform);
     bool connect(const QHostAddress &host, quint16 port);
     bool connect(const QString &hostName, quint16 port, NetworkLayerProtocol protocol = AnyIPProtocol);
+    qint64 connectAndSend(const QHostAddress &host, quint16 port, const QByteArray &data);
+    qint64 connectAndSend(const QString &hostName, quint16 port, const QByteArray &data, NetworkLayerProtocol protocol = AnyIPProtocol);
     bool close();
     bool listen(int backlog);
     bool setOption(SocketOption option, const QVariant &value);
@@ -160,18 +171,60 @@ public:
     qint64 sendall(const QByteArray &data);
     QByteArray recvfrom(qint64 size, QHostAddress *addr, quint16 *port);
     qint64 sendto(const QByteArray &data, const QHostAddress &addr, quint16 port);
+    qint64 sendv(const QList<QByteArray> &data);
+    qint64 recvv(QList<QByteArray> &buffers);
+    qint64 sendfile(QFile &file, qint64 offset = 0, qint64 length = -1);
+    qint64 sendfile(int fileDescriptor, qint64 offset = 0, qint64 length = -1);
+    qint64 splice(Socket &source, qint64 length = -1);
+    int recvmany(DatagramBatch &batch);
+    int sendmany(const DatagramBatch &batch);
 
     static QList<QHostAddress> resolve(const QString &hostName);
     void setDnsCache(QSharedPointer<SocketDnsCache> dnsCache);
+    void setConnectAttemptDelay(int msecs);
+    int connectAttemptDelay() const;
+    void setConnectTimeout(int msecs);
+    int connectTimeout() const;
 protected:
     SocketPrivate * const d_ptr;
 private:
+    Socket(SocketPrivate *d);
     Q_DECLARE_PRIVATE(Socket)
     Q_DISABLE_COPY(Socket)
+    friend class SocketPrivate;
 };
 
 Q_DECLARE_OPERATORS_FOR_FLAGS(Socket::BindMode)
 
+// the datagrams of Socket::recvmany() and Socket::sendmany(). the payloads are stored in one arena allocated
+// beforehand, so a batch can be reused for every call without allocation.
+class DatagramBatchPrivate;
+class DatagramBatch
+{
+public:
+    explicit DatagramBatch(int capacity = 64, int datagramSize = 1024 * 2);
+    virtual ~DatagramBatch();
+public:
+    int capacity() const;
+    int datagramSize() const;
+    int size() const;
+    bool isEmpty() const;
+    void clear();
+    bool append(const char *data, int size, const QHostAddress &addr, quint16 port);
+    bool append(const QByteArray &data, const QHostAddress &addr, quint16 port);
+    const char *data(int i) const;
+    int length(int i) const;
+    bool isTruncated(int i) const;
+    QByteArray datagram(int i) const;
+    QHostAddress address(int i) const;
+    quint16 port(int i) const;
+private:
+    DatagramBatchPrivate * const d_ptr;
+    Q_DECLARE_PRIVATE(DatagramBatch)
+    Q_DISABLE_COPY(DatagramBatch)
+    friend class SocketPrivate;
+};
+
 class PollPrivate;
 class Poll
 {
@@ -195,6 +248,15 @@ public:
     virtual ~SocketDnsCache();
 public:
     QList<QHostAddress> resolve(const QString &hostName);
+    void setResolver(QSharedPointer<DnsResolver> resolver);
+    QSharedPointer<DnsResolver> resolver() const;
+    void setDefaultTtl(int secs);
+    int defaultTtl() const;
+    void setNegativeTtl(int secs);
+    int negativeTtl() const;
+    void clear();
+    quint64 hits() const;
+    quint64 misses() const;
 private:
     SocketDnsCachePrivate * const d_ptr;
     Q_DECLARE_PRIVATE(SocketDnsCache)
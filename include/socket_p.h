@@ -4,6 +4,8 @@
 #include <QtCore/qsharedpointer.h>
 #include <QtCore/qstring.h>
 #include <QtCore/qbytearray.h>
+#include <QtCore/qvector.h>
+#include <QtCore/qmap.h>
 #include <QtNetwork/qhostaddress.h>
 #include "socket.h"
 
@@ -50,6 +52,7 @@ class SocketPrivate
 public:
     SocketPrivate(Socket::NetworkLayerProtocol protocol, Socket::SocketType type, Socket *parent);
     SocketPrivate(qintptr socketDescriptor, Socket *parent);
+    SocketPrivate(qintptr socketDescriptor, const SocketPrivate *listener);
     virtual ~SocketPrivate();
 public:
     QString getErrorString() const;
@@ -58,10 +61,13 @@ public:
     bool isValid() const {return fd > 0 && error == Socket::NoError;}
 
     Socket *accept();
+    QList<Socket*> acceptMany(int maxCount);
     bool bind(const QHostAddress &address, quint16 port = 0, Socket::BindMode mode = Socket::DefaultForPlatform);
     bool bind(quint16 port = 0, Socket::BindMode mode = Socket::DefaultForPlatform);
     bool connect(const QHostAddress &host, quint16 port);
     bool connect(const QString &hostName, quint16 port, Socket::NetworkLayerProtocol protocol = Socket::AnyIPProtocol);
+    qint64 connectAndSend(const QHostAddress &host, quint16 port, const char *data, qint64 size);
+    qint64 connectAndSend(const QString &hostName, quint16 port, const char *data, qint64 size, Socket::NetworkLayerProtocol protocol);
     bool close();
     bool listen(int backlog);
     bool setOption(Socket::SocketOption option, const QVariant &value);
@@ -69,10 +75,22 @@ public:
     QVariant option(Socket::SocketOption option) const;
     qint64 recv(char *data, qint64 size, bool all);
     qint64 send(const char *data, qint64 size, bool all = true);
+    qint64 sendv(const QList<QByteArray> &data);
+    qint64 recvv(QList<QByteArray> &buffers);
+    qint64 sendfile(int fileDescriptor, qint64 offset, qint64 length);
+    qint64 splice(SocketPrivate *source, qint64 length);
     qint64 recvfrom(char *data, qint64 size, QHostAddress *addr, quint16 *port);
     qint64 sendto(const char *data, qint64 size, const QHostAddress &addr, quint16 port);
+    int recvmany(DatagramBatch *batch);
+    int sendmany(const DatagramBatch *batch);
 private:
+    bool lookup(const QString &hostName, Socket::NetworkLayerProtocol protocol, QList<QHostAddress> *candidates);
+    bool connectToAny(const QList<QHostAddress> &candidates, quint16 port, bool fresh);
+    bool connectWithTimeout(const QHostAddress &host, quint16 port);
+    bool connectInParallel(const QList<QHostAddress> &addresses, quint16 port);
+    void takeConnection(SocketPrivate *other);
     bool fetchConnectionParameters();
+    Socket *makeAcceptedSocket(qintptr acceptedDescriptor, const qt_sockaddr *peer);
     void setPortAndAddress(quint16 port, const QHostAddress &address, qt_sockaddr *aa, QT_SOCKLEN_T *sockAddrSize);
     bool createSocket();
 protected:
@@ -89,10 +107,38 @@ private:
     quint16 peerPort;
     qintptr fd;
     QSharedPointer<SocketDnsCache> dnsCache;
+    QMap<Socket::SocketOption, QVariant> presetOptions;
+    int connectAttemptDelay;
+    int connectTimeout;
+    PersistentIoWatcher readWatcher;
+    PersistentIoWatcher writeWatcher;
+    bool udpGso;
+    bool udpGro;
 
     Q_DECLARE_PUBLIC(Socket)
 };
 
+
+class DatagramBatchPrivate
+{
+public:
+    struct Entry
+    {
+        int offset;
+        int length;
+        QHostAddress addr;
+        quint16 port;
+        bool truncated;
+    };
+    DatagramBatchPrivate(int capacity, int datagramSize);
+public:
+    QByteArray arena;
+    QVector<Entry> entries;
+    int capacity;
+    int datagramSize;
+    int used;
+};
+
 #ifdef Q_OS_WIN
 void initWinSock();
 void freeWinSock();
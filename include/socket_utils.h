@@ -1,6 +1,7 @@
 #ifndef QTNG_SOCKET_UTILS_H
 #define QTNG_SOCKET_UTILS_H
 
+#include <functional>
 #include <QtCore/qsharedpointer.h>
 #include "socket.h"
 
@@ -44,6 +45,8 @@ public:
     virtual QByteArray recvall(qint64 size) = 0;
     virtual qint64 send(const QByteArray &data) = 0;
     virtual qint64 sendall(const QByteArray &data) = 0;
+    virtual qint64 sendv(const QList<QByteArray> &data) = 0;
+    virtual qint64 recvv(QList<QByteArray> &buffers) = 0;
 public:
     static QSharedPointer<SocketLike> rawSocket(QSharedPointer<Socket> s);
     static QSharedPointer<SocketLike> rawSocket(Socket *s) { return rawSocket(QSharedPointer<Socket>(s)); }
@@ -53,6 +56,47 @@ public:
 #endif
 };
 
+
+// a growable ring buffer which receives from a SocketLike into its free space directly. parsers can peek, read lines
+// and consume the data without allocating for every read or moving the data left.
+class SocketBuffer
+{
+public:
+    explicit SocketBuffer(QSharedPointer<SocketLike> connection = QSharedPointer<SocketLike>(), int capacity = 1024 * 8);
+public:
+    QSharedPointer<SocketLike> connection() const { return conn; }
+    void setConnection(QSharedPointer<SocketLike> connection) { conn = connection; }
+    int size() const { return count; }
+    bool isEmpty() const { return count == 0; }
+    int capacity() const { return storage.size(); }
+
+    qint64 receive();
+    bool fill(int size);
+    int indexOf(char c, int maxLength = -1) const;
+    QByteArray readLine(int maxLength = -1);
+    QByteArray peek(int size) const;
+    QByteArray read(int size);
+    QByteArray readAll() { return read(count); }
+    void consume(int size);
+    void append(const char *data, int size);
+    void append(const QByteArray &data) { append(data.constData(), data.size()); }
+    void clear();
+private:
+    void reserve(int size);
+private:
+    QSharedPointer<SocketLike> conn;
+    QByteArray storage;
+    int head;
+    int count;
+};
+
+
+class CoroutineGroup;
+
+// accept connections in batches and spawn a handler coroutine in `operations` for each, until the server socket fails or is closed.
+void acceptLoop(Socket *server, CoroutineGroup *operations, const std::function<void(QSharedPointer<Socket>)> &handler,
+                int batchSize = 64);
+
 QTNETWORKNG_NAMESPACE_END
 
 #endif // QTNG_SOCKET_UTILS_H
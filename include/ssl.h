@@ -55,6 +55,7 @@ public:
     QString peerVerifyName() const;
     int peerVerifyDepth() const;
     PrivateKey privateKey() const;
+    bool isKernelTlsEnabled() const;
 
     void addCaCertificate(const Certificate &certificate);
     void addCaCertificates(const QList<Certificate> &certificates);
@@ -68,6 +69,7 @@ public:
                        Ssl::EncodingFormat format = Ssl::Pem, const QByteArray &passPhrase = QByteArray());
     void setSslProtocol(Ssl::SslProtocol protocol);
     void setAllowedNextProtocols(const QList<QByteArray> &protocols);
+    void setKernelTlsEnabled(bool enabled);
 public:
     static QList<SslCipher> supportedCiphers();
 public:
@@ -137,6 +139,28 @@ QDebug &operator<<(QDebug &debug, const SslError &error);
 QDebug &operator<<(QDebug &debug, const SslError::Error &error);
 
 
+// client side session cache, the sessions are stored in DER form and keyed by `host:port`.
+class SslSessionCachePrivate;
+class SslSessionCache
+{
+public:
+    explicit SslSessionCache(int capacity = 256);
+    virtual ~SslSessionCache();
+public:
+    QByteArray session(const QString &key) const;
+    void setSession(const QString &key, const QByteArray &session);
+    void remove(const QString &key);
+    void clear();
+    int size() const;
+    int capacity() const;
+    void setCapacity(int capacity);
+private:
+    SslSessionCachePrivate * const d_ptr;
+    Q_DECLARE_PRIVATE(SslSessionCache)
+    Q_DISABLE_COPY(SslSessionCache)
+};
+
+
 class Socket;
 class SslSocketPrivate;
 class SslSocket
@@ -179,6 +203,11 @@ public:
     SslConfiguration sslConfiguration() const;
     QList<SslError> sslErrors() const;
     void setSslConfiguration(const SslConfiguration &configuration);
+    void setSessionCache(QSharedPointer<SslSessionCache> cache, const QString &sessionKey = QString());
+    QSharedPointer<SslSessionCache> sessionCache() const;
+    bool isSessionResumed() const;
+    bool isKernelTlsSendEnabled() const;
+    bool isKernelTlsReceiveEnabled() const;
 public:
     Socket::SocketError error() const;
     QString errorString() const;
@@ -212,6 +241,9 @@ public:
     QByteArray recvall(qint64 size);
     qint64 send(const QByteArray &data);
     qint64 sendall(const QByteArray &data);
+    qint64 sendv(const QList<QByteArray> &data);
+    qint64 recvv(QList<QByteArray> &buffers);
+    qint64 sendfile(QFile &file, qint64 offset = 0, qint64 length = -1);
 private:
     SslSocketPrivate * const d_ptr;
     Q_DECLARE_PRIVATE(SslSocket)
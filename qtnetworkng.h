@@ -11,6 +11,8 @@
 #include "include/http_proxy.h"
 #include "include/http_utils.h"
 #include "include/socks5_proxy.h"
+#include "include/dns.h"
+#include "include/loop_pool.h"
 
 #ifdef QTNETWOKRNG_USE_SSL
 #include "include/ssl.h"
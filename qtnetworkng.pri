@@ -16,7 +16,9 @@ SOURCES += \
     $$PWD/src/socket_utils.cpp \
     $$PWD/src/http_utils.cpp \
     $$PWD/src/http_proxy.cpp \
-    $$PWD/src/socks5_proxy.cpp
+    $$PWD/src/socks5_proxy.cpp \
+    $$PWD/src/dns.cpp \
+    $$PWD/src/loop_pool.cpp
 
 HEADERS += \
     $$PWD/qtnetworkng.h \
@@ -25,6 +27,7 @@ HEADERS += \
     $$PWD/include/socket.h \
     $$PWD/include/socket_p.h \
     $$PWD/include/eventloop.h \
+    $$PWD/include/eventloop_p.h \
     $$PWD/include/locks.h \
     $$PWD/include/coroutine_utils.h \
     $$PWD/include/coroutine_p.h \
@@ -35,7 +38,9 @@ HEADERS += \
     $$PWD/include/http_utils.h \
     $$PWD/include/http_proxy.h \
     $$PWD/include/socks5_proxy.h \
-    $$PWD/include/deferred.h
+    $$PWD/include/deferred.h \
+    $$PWD/include/dns.h \
+    $$PWD/include/loop_pool.h
 
 windows {
     SOURCES += $$PWD/src/socket_win.cpp \
@@ -50,6 +55,8 @@ unix | macos {
 networkng_ev {
     LIBS += -lev
     SOURCES += $$PWD/src/eventloop_ev.cpp
+} else: linux: networkng_epoll {
+    SOURCES += $$PWD/src/eventloop_epoll.cpp
 } else {
     SOURCES += $$PWD/src/eventloop_qt.cpp
 }
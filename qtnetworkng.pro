@@ -11,7 +11,9 @@ SOURCES += tests/simple_test.cpp \
     tests/sleep_coroutines.cpp \
     tests/test_crypto.cpp \
     tests/test_ssl.cpp \
-    tests/test_coroutines.cpp
+    tests/test_coroutines.cpp \
+    tests/test_dns.cpp \
+    tests/bench_eventloop.cpp
 #DEFINES += QSOCKETNG_DEBUG
 
 include(qtnetworkng.pri)
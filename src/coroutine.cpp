@@ -1,5 +1,17 @@
+#include <new>
+#include <algorithm>
+#include <string.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qmap.h>
+#include <QtCore/qatomic.h>
+#include <QtCore/qvarlengtharray.h>
 #include "../include/coroutine_p.h"
 
+#ifdef Q_OS_UNIX
+# include <unistd.h>
+# include <sys/mman.h>
+#endif
+
 QTNETWORKNG_NAMESPACE_BEGIN
 
 CoroutineException::CoroutineException() throw ()
@@ -83,5 +95,250 @@ BaseCoroutine *BaseCoroutine::current()
     return currentCoroutine().get();
 }
 
+static QAtomicInteger<quintptr> defaultStackSizeValue(1024 * 1024 * 8);
+
+size_t BaseCoroutine::defaultStackSize()
+{
+    return static_cast<size_t>(defaultStackSizeValue.load());
+}
+
+void BaseCoroutine::setDefaultStackSize(size_t stackSize)
+{
+    if(stackSize == 0) {
+        qWarning("the stack size of coroutine can not be zero.");
+        return;
+    }
+    defaultStackSizeValue.store(static_cast<quintptr>(stackSize));
+}
+
+// 开始实现 CoroutineStackPool
+
+namespace {
+
+struct StackPoolSettings
+{
+    StackPoolSettings()
+        :highWaterMark(32)
+    {
+        sizeClasses << 1024 * 64 << 1024 * 256 << 1024 * 1024 << 1024 * 1024 * 8;
+    }
+    QMutex mutex;
+    QList<size_t> sizeClasses;
+    int highWaterMark;
+};
+
+Q_GLOBAL_STATIC(StackPoolSettings, stackPoolSettings)
+
+
+#ifdef Q_OS_UNIX
+size_t pageSize()
+{
+    static const size_t size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return size;
+}
+#endif
+
+
+// the stack grows down, so an overflow hits the PROT_NONE page below the stack instead of other memory.
+void *mapStack(size_t size)
+{
+#ifdef Q_OS_UNIX
+    const size_t guardSize = pageSize();
+    void *base = mmap(NULL, size + guardSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(base == MAP_FAILED) {
+        return 0;
+    }
+    if(mprotect(base, guardSize, PROT_NONE) < 0) {
+        qWarning("can not protect the guard page of coroutine stack.");
+    }
+    return static_cast<char*>(base) + guardSize;
+#else
+    return operator new(size, std::nothrow);
+#endif
+}
+
+
+void unmapStack(void *stack, size_t size)
+{
+#ifdef Q_OS_UNIX
+    const size_t guardSize = pageSize();
+    munmap(static_cast<char*>(stack) - guardSize, size + guardSize);
+#else
+    Q_UNUSED(size);
+    operator delete(stack);
+#endif
+}
+
+
+struct ThreadStackPool
+{
+    ~ThreadStackPool() { clear(); }
+    void clear();
+    int size() const;
+    QMap<size_t, QList<void*>> freeStacks;
+};
+
+
+void ThreadStackPool::clear()
+{
+    for(QMap<size_t, QList<void*>>::const_iterator itor = freeStacks.constBegin(); itor != freeStacks.constEnd(); ++itor) {
+        for(void *stack: itor.value()) {
+            unmapStack(stack, itor.key());
+        }
+    }
+    freeStacks.clear();
+}
+
+
+int ThreadStackPool::size() const
+{
+    int total = 0;
+    for(const QList<void*> &stacks: freeStacks) {
+        total += stacks.size();
+    }
+    return total;
+}
+
+
+ThreadStackPool *currentStackPool()
+{
+    static QThreadStorage<ThreadStackPool*> storage;
+    if(!storage.hasLocalData()) {
+        storage.setLocalData(new ThreadStackPool());
+    }
+    return storage.localData();
+}
+
+}
+
+
+void *allocateCoroutineStack(size_t *stackSize)
+{
+    size_t size = *stackSize;
+    bool pooled = false;
+    {
+        StackPoolSettings *settings = stackPoolSettings();
+        QMutexLocker locker(&settings->mutex);
+        for(size_t sizeClass: settings->sizeClasses) {
+            if(sizeClass >= size) {
+                size = sizeClass;
+                pooled = true;
+                break;
+            }
+        }
+    }
+    if(pooled) {
+        QList<void*> &stacks = currentStackPool()->freeStacks[size];
+        if(!stacks.isEmpty()) {
+            *stackSize = size;
+            return stacks.takeLast();
+        }
+    }
+    void *stack = mapStack(size);
+    if(stack) {
+        *stackSize = size;
+    }
+    return stack;
+}
+
+
+void releaseCoroutineStack(void *stack, size_t stackSize)
+{
+    bool pooled;
+    int highWaterMark;
+    {
+        StackPoolSettings *settings = stackPoolSettings();
+        QMutexLocker locker(&settings->mutex);
+        pooled = settings->sizeClasses.contains(stackSize);
+        highWaterMark = settings->highWaterMark;
+    }
+    if(pooled) {
+        QList<void*> &stacks = currentStackPool()->freeStacks[stackSize];
+        if(stacks.size() < highWaterMark) {
+            // keep the untouched part of stack zero, so coroutineStackUsage() works for the next coroutine.
+            size_t used = coroutineStackUsage(stack, stackSize);
+            memset(static_cast<char*>(stack) + stackSize - used, 0, used);
+            stacks.append(stack);
+            return;
+        }
+    }
+    unmapStack(stack, stackSize);
+}
+
+
+// new stacks are zero filled, the lowest non-zero byte is the deepest position ever written.
+size_t coroutineStackUsage(void *stack, size_t stackSize)
+{
+    if(!stack || !stackSize) {
+        return 0;
+    }
+    const char *begin = static_cast<const char*>(stack);
+    const char *end = begin + stackSize;
+    const char *p = begin;
+#if defined(Q_OS_LINUX)
+    // skip the pages never touched. reading them would fault in the zero page.
+    const size_t size = pageSize();
+    const size_t pages = (stackSize + size - 1) / size;
+    QVarLengthArray<unsigned char, 2048> residents(static_cast<int>(pages));
+    if(mincore(const_cast<char*>(begin), stackSize, residents.data()) == 0) {
+        size_t i = 0;
+        while(i < pages && !(residents[static_cast<int>(i)] & 1)) {
+            ++i;
+        }
+        p = begin + qMin(i * size, stackSize);
+    }
+#endif
+    while(p < end && *p == 0) {
+        ++p;
+    }
+    return static_cast<size_t>(end - p);
+}
+
+
+void CoroutineStackPool::setSizeClasses(const QList<size_t> &sizeClasses)
+{
+    QList<size_t> sorted = sizeClasses;
+    std::sort(sorted.begin(), sorted.end());
+    StackPoolSettings *settings = stackPoolSettings();
+    QMutexLocker locker(&settings->mutex);
+    settings->sizeClasses = sorted;
+}
+
+
+QList<size_t> CoroutineStackPool::sizeClasses()
+{
+    StackPoolSettings *settings = stackPoolSettings();
+    QMutexLocker locker(&settings->mutex);
+    return settings->sizeClasses;
+}
+
+
+void CoroutineStackPool::setHighWaterMark(int stacks)
+{
+    StackPoolSettings *settings = stackPoolSettings();
+    QMutexLocker locker(&settings->mutex);
+    settings->highWaterMark = qMax(0, stacks);
+}
+
+
+int CoroutineStackPool::highWaterMark()
+{
+    StackPoolSettings *settings = stackPoolSettings();
+    QMutexLocker locker(&settings->mutex);
+    return settings->highWaterMark;
+}
+
+
+int CoroutineStackPool::cachedStacks()
+{
+    return currentStackPool()->size();
+}
+
+
+void CoroutineStackPool::clear()
+{
+    currentStackPool()->clear();
+}
+
 
 QTNETWORKNG_NAMESPACE_END
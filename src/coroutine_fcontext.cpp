@@ -4,10 +4,6 @@
 #include <QtCore/qlist.h>
 #include "../include/coroutine_p.h"
 
-#ifdef Q_OS_UNIX
-# include <sys/mman.h>
-#endif
-
 QTNETWORKNG_NAMESPACE_BEGIN
 
 #if (defined(i386) || defined(__i386__) || defined(__i386) \
@@ -90,15 +86,7 @@ BaseCoroutinePrivate::BaseCoroutinePrivate(BaseCoroutine *q, BaseCoroutine *prev
       bad(false), exception(0), context(0)
 {
     if(stackSize) {
-#ifdef Q_OS_UNIX
-#ifdef MAP_GROWSDOWN
-        stack = mmap(NULL, this->stackSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_GROWSDOWN, -1, 0);
-#else
-        stack = mmap(NULL, this->stackSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-#endif
-#else
-        stack = operator new(stackSize);
-#endif
+        stack = allocateCoroutineStack(&this->stackSize);
         if(!stack) {
             qFatal("Coroutine can not malloc new memroy.");
             bad = true;
@@ -122,11 +110,7 @@ BaseCoroutinePrivate::~BaseCoroutinePrivate()
     }
 
     if(stack) {
-#ifdef Q_OS_UNIX
-        munmap(stack, stackSize);
-#else
-        operator delete(stack);
-#endif
+        releaseCoroutineStack(stack, stackSize);
     }
 }
 
@@ -298,4 +282,18 @@ void BaseCoroutine::setPrevious(BaseCoroutine *previous)
     d->previous = previous;
 }
 
+
+size_t BaseCoroutine::stackSize() const
+{
+    Q_D(const BaseCoroutine);
+    return d->stackSize;
+}
+
+
+size_t BaseCoroutine::peakStackUsage() const
+{
+    Q_D(const BaseCoroutine);
+    return coroutineStackUsage(d->stack, d->stackSize);
+}
+
 QTNETWORKNG_NAMESPACE_END
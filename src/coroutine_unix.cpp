@@ -1,7 +1,6 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <ucontext.h>
-#include <sys/mman.h>
 #include <QtCore/qdebug.h>
 #include <QtCore/qlist.h>
 #include "../include/coroutine_p.h"
@@ -73,8 +72,7 @@ BaseCoroutinePrivate::BaseCoroutinePrivate(BaseCoroutine *q, BaseCoroutine *prev
       bad(false), exception(0), context(0)
 {
     if(stackSize) {
-//        stack = operator new(stackSize);
-        stack = mmap(NULL, this->stackSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_GROWSDOWN, -1, 0);
+        stack = allocateCoroutineStack(&this->stackSize);
         if(!stack) {
             qFatal("Coroutine can not malloc new memroy.");
             bad = true;
@@ -93,8 +91,7 @@ BaseCoroutinePrivate::~BaseCoroutinePrivate()
         qWarning() << "deleting running BaseCoroutine" << this;
     }
     if(stack) {
-//        operator delete(stack);
-        munmap(stack, stackSize);
+        releaseCoroutineStack(stack, stackSize);
     }
 
     if(currentCoroutine().get() == q)
@@ -283,4 +280,18 @@ void BaseCoroutine::setPrevious(BaseCoroutine *previous)
     d->previous = previous;
 }
 
+
+size_t BaseCoroutine::stackSize() const
+{
+    Q_D(const BaseCoroutine);
+    return d->stackSize;
+}
+
+
+size_t BaseCoroutine::peakStackUsage() const
+{
+    Q_D(const BaseCoroutine);
+    return coroutineStackUsage(d->stack, d->stackSize);
+}
+
 QTNETWORKNG_NAMESPACE_END
@@ -258,4 +258,18 @@ void BaseCoroutine::setPrevious(BaseCoroutine *previous)
     d->previous = previous;
 }
 
+
+size_t BaseCoroutine::stackSize() const
+{
+    Q_D(const BaseCoroutine);
+    return d->stackSize;
+}
+
+
+// fibers do not expose their stacks.
+size_t BaseCoroutine::peakStackUsage() const
+{
+    return 0;
+}
+
 QTNETWORKNG_NAMESPACE_END
@@ -0,0 +1,694 @@
+#include <QtCore/qfile.h>
+#include <QtCore/qmap.h>
+#include <QtCore/qregexp.h>
+#include <QtCore/qurl.h>
+#include <QtCore/qendian.h>
+#include <QtCore/qpointer.h>
+#include "../include/dns.h"
+#include "../include/socket.h"
+#include "../include/coroutine_utils.h"
+#ifdef QTNETWOKRNG_USE_SSL
+#include "../include/random.h"
+#elif QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+#include <QtCore/qrandom.h>
+#endif
+
+QTNETWORKNG_NAMESPACE_BEGIN
+
+// a tiny DNS stub resolver, see rfc1035. it sends A/AAAA queries by UDP, and falls back to TCP if the answer is truncated.
+
+namespace {
+
+const quint16 ClassIN = 1;
+const quint16 TypeSOA = 6;
+const int MaxUdpPacketSize = 1024 * 4;
+
+enum ResponseCode {
+    NoErrorCode = 0,
+    FormatErrorCode = 1,
+    ServerFailureCode = 2,
+    NameErrorCode = 3,
+    NotImplementedCode = 4,
+    RefusedCode = 5,
+};
+
+struct DnsAnswer
+{
+    DnsAnswer()
+        :rcode(-1), ttl(0), truncated(false) {}
+    int rcode;
+    quint32 ttl;
+    bool truncated;
+    QList<QHostAddress> addresses;
+};
+
+
+inline quint16 readUInt16(const QByteArray &packet, int pos)
+{
+    return qFromBigEndian<quint16>(reinterpret_cast<const uchar*>(packet.constData() + pos));
+}
+
+
+inline quint32 readUInt32(const QByteArray &packet, int pos)
+{
+    return qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(packet.constData() + pos));
+}
+
+
+QByteArray encodeName(QString hostName)
+{
+    if(hostName.endsWith(QLatin1Char('.'))) {
+        hostName.chop(1);
+    }
+    const QByteArray &ace = QUrl::toAce(hostName);
+    if(ace.isEmpty()) {
+        return QByteArray();
+    }
+    QByteArray encoded;
+    foreach(const QByteArray &label, ace.split('.')) {
+        if(label.isEmpty() || label.size() > 63) {
+            return QByteArray();
+        }
+        encoded.append(static_cast<char>(label.size()));
+        encoded.append(label);
+    }
+    encoded.append('\0');
+    if(encoded.size() > 255) {
+        return QByteArray();
+    }
+    return encoded;
+}
+
+
+// answers are matched by transaction id, a predictable id makes spoofed answers easy to forge.
+quint16 newTransactionId()
+{
+    quint16 id = 0;
+#ifdef QTNETWOKRNG_USE_SSL
+    const QByteArray &bytes = randomBytes(2);
+    memcpy(&id, bytes.constData(), 2);
+#elif QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+    id = static_cast<quint16>(QRandomGenerator::system()->generate() & 0xffff);
+#else
+    QFile urandom(QString::fromLatin1("/dev/urandom"));
+    if(!urandom.open(QIODevice::ReadOnly) || urandom.read(reinterpret_cast<char*>(&id), 2) != 2) {
+        id = static_cast<quint16>(qrand() & 0xffff);
+    }
+#endif
+    return id;
+}
+
+
+QByteArray buildQuery(quint16 id, const QByteArray &encodedName, quint16 type)
+{
+    QByteArray packet(12, '\0');
+    uchar *header = reinterpret_cast<uchar*>(packet.data());
+    qToBigEndian<quint16>(id, header);
+    qToBigEndian<quint16>(0x0100, header + 2); // recursion desired.
+    qToBigEndian<quint16>(1, header + 4); // one question.
+    packet.append(encodedName);
+    uchar question[4];
+    qToBigEndian<quint16>(type, question);
+    qToBigEndian<quint16>(ClassIN, question + 2);
+    packet.append(reinterpret_cast<const char*>(question), 4);
+    return packet;
+}
+
+
+bool skipName(const QByteArray &packet, int *pos)
+{
+    while(*pos < packet.size()) {
+        quint8 length = static_cast<quint8>(packet.at(*pos));
+        if((length & 0xc0) == 0xc0) { // compression pointer ends the name.
+            if(*pos + 2 > packet.size()) {
+                return false;
+            }
+            *pos += 2;
+            return true;
+        } else if(length & 0xc0) {
+            return false;
+        }
+        *pos += 1 + length;
+        if(length == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// compare the echoed question to the query. names are compared case-insensitive, see rfc4343.
+bool isSameQuestion(const QByteArray &packet, const QByteArray &query)
+{
+    if(packet.size() < query.size() || readUInt16(packet, 4) != 1) {
+        return false;
+    }
+    for(int i = 12; i < query.size(); ++i) {
+        char c1 = packet.at(i), c2 = query.at(i);
+        if(c1 != c2 && QChar::toLower(static_cast<uint>(static_cast<uchar>(c1)))
+                != QChar::toLower(static_cast<uint>(static_cast<uchar>(c2)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+bool parseResponse(const QByteArray &packet, const QByteArray &query, quint16 type, DnsAnswer *answer)
+{
+    if(packet.size() < 12 || readUInt16(packet, 0) != readUInt16(query, 0) || !isSameQuestion(packet, query)) {
+        return false;
+    }
+    quint16 flags = readUInt16(packet, 2);
+    if(!(flags & 0x8000)) {
+        return false;
+    }
+    answer->truncated = (flags & 0x0200) != 0;
+    answer->rcode = flags & 0x000f;
+    answer->addresses.clear();
+    answer->ttl = 0;
+
+    int questions = readUInt16(packet, 4);
+    int answers = readUInt16(packet, 6);
+    int authorities = readUInt16(packet, 8);
+    int pos = 12;
+    for(int i = 0; i < questions; ++i) {
+        if(!skipName(packet, &pos) || pos + 4 > packet.size()) {
+            return false;
+        }
+        pos += 4;
+    }
+
+    bool hasTtl = false;
+    quint32 minTtl = 0;
+    for(int i = 0; i < answers + authorities; ++i) {
+        if(!skipName(packet, &pos) || pos + 10 > packet.size()) {
+            return answer->truncated;
+        }
+        quint16 rtype = readUInt16(packet, pos);
+        quint16 rclass = readUInt16(packet, pos + 2);
+        quint32 ttl = readUInt32(packet, pos + 4);
+        int rdlength = readUInt16(packet, pos + 8);
+        pos += 10;
+        if(pos + rdlength > packet.size()) {
+            return answer->truncated;
+        }
+        if(i < answers) {
+            QHostAddress address;
+            if(rclass == ClassIN && rtype == type && type == DnsResolver::A && rdlength == 4) {
+                address.setAddress(readUInt32(packet, pos));
+            } else if(rclass == ClassIN && rtype == type && type == DnsResolver::AAAA && rdlength == 16) {
+                address.setAddress(reinterpret_cast<const quint8*>(packet.constData() + pos));
+            }
+            if(!address.isNull()) {
+                answer->addresses.append(address);
+                minTtl = hasTtl ? qMin(minTtl, ttl) : ttl;
+                hasTtl = true;
+            }
+        } else if(answer->addresses.isEmpty() && rtype == TypeSOA) {
+            // negative answer is cached for min(SOA.ttl, SOA.minimum), see rfc2308.
+            int soaPos = pos;
+            if(skipName(packet, &soaPos) && skipName(packet, &soaPos) && soaPos + 20 <= pos + rdlength) {
+                minTtl = qMin(ttl, readUInt32(packet, soaPos + 16));
+                hasTtl = true;
+            }
+        }
+        pos += rdlength;
+    }
+    answer->ttl = hasTtl ? minTtl : 0;
+    return true;
+}
+
+
+// unlike Timeout, it tells whether its own TimeoutException is raised. the one of caller's Timeout must pass through.
+class QueryTimeout
+{
+public:
+    explicit QueryTimeout(int msecs)
+        :msecs(msecs), callbackId(0), expired(false) { restart(); }
+    ~QueryTimeout() { cancel(); }
+    void restart()
+    {
+        cancel();
+        expired = false;
+        if(msecs <= 0) {
+            return;
+        }
+        QPointer<BaseCoroutine> current = BaseCoroutine::current();
+        bool *flag = &expired;
+        callbackId = EventLoopCoroutine::get()->callLater(msecs, new LambdaFunctor([current, flag] {
+            if(!current.isNull()) {
+                *flag = true;
+                current->raise(new TimeoutException());
+            }
+        }));
+    }
+    void cancel()
+    {
+        if(callbackId) {
+            EventLoopCoroutine::get()->cancelCall(callbackId);
+            callbackId = 0;
+        }
+    }
+public:
+    int msecs;
+    int callbackId;
+    bool expired;
+};
+
+
+bool isSameAddress(const QHostAddress &a, const QHostAddress &b)
+{
+    if(a == b) {
+        return true;
+    }
+    bool ok1 = false, ok2 = false;
+    quint32 a4 = a.toIPv4Address(&ok1);
+    quint32 b4 = b.toIPv4Address(&ok2);
+    return ok1 && ok2 && a4 == b4;
+}
+
+}
+
+// 开始写 DnsResolverPrivate 的实现
+class DnsResolverPrivate
+{
+public:
+    DnsResolverPrivate();
+public:
+    QList<QHostAddress> lookupHosts(const QString &hostName, quint16 type) const;
+    QStringList candidateNames(const QString &hostName) const;
+    bool queryName(const QByteArray &encodedName, quint16 type, DnsAnswer *answer);
+    bool queryServer(const QHostAddress &server, const QByteArray &packet, quint16 type, DnsAnswer *answer);
+    bool queryServerTcp(const QHostAddress &server, const QByteArray &packet, quint16 type, DnsAnswer *answer);
+public:
+    QList<QHostAddress> nameServers;
+    quint16 port;
+    QStringList searchDomains;
+    QMap<QString, QList<QHostAddress>> hosts;
+    int ndots;
+    int timeout;
+    int attempts;
+};
+
+
+DnsResolverPrivate::DnsResolverPrivate()
+    :port(53), ndots(1), timeout(5000), attempts(2)
+{
+}
+
+
+QList<QHostAddress> DnsResolverPrivate::lookupHosts(const QString &hostName, quint16 type) const
+{
+    QString name = hostName.toLower();
+    if(name.endsWith(QLatin1Char('.'))) {
+        name.chop(1);
+    }
+    QList<QHostAddress> result;
+    foreach(const QHostAddress &address, hosts.value(name)) {
+        if(type == 0 || (type == DnsResolver::A && address.protocol() == QAbstractSocket::IPv4Protocol)
+                || (type == DnsResolver::AAAA && address.protocol() == QAbstractSocket::IPv6Protocol)) {
+            result.append(address);
+        }
+    }
+    return result;
+}
+
+
+QStringList DnsResolverPrivate::candidateNames(const QString &hostName) const
+{
+    QStringList names;
+    if(hostName.endsWith(QLatin1Char('.'))) {
+        names.append(hostName);
+        return names;
+    }
+    bool enoughDots = hostName.count(QLatin1Char('.')) >= ndots;
+    if(enoughDots) {
+        names.append(hostName);
+    }
+    foreach(const QString &domain, searchDomains) {
+        names.append(hostName + QLatin1Char('.') + domain);
+    }
+    if(!enoughDots) {
+        names.append(hostName);
+    }
+    return names;
+}
+
+
+bool DnsResolverPrivate::queryName(const QByteArray &encodedName, quint16 type, DnsAnswer *answer)
+{
+    for(int attempt = 0; attempt < attempts; ++attempt) {
+        for(int i = 0; i < nameServers.size(); ++i) {
+            DnsAnswer t;
+            const QByteArray &packet = buildQuery(newTransactionId(), encodedName, type);
+            if(!queryServer(nameServers.at(i), packet, type, &t)) {
+                continue;
+            }
+            // SERVFAIL, REFUSED and other errors mean this server can not help, try next server.
+            if(t.rcode == NoErrorCode || t.rcode == NameErrorCode) {
+                *answer = t;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+
+bool DnsResolverPrivate::queryServer(const QHostAddress &server, const QByteArray &packet, quint16 type, DnsAnswer *answer)
+{
+    Socket::NetworkLayerProtocol protocol = Socket::IPv4Protocol;
+    if(server.protocol() == QAbstractSocket::IPv6Protocol) {
+        protocol = Socket::IPv6Protocol;
+    }
+    QueryTimeout out(timeout);
+    try {
+        Socket socket(protocol, Socket::UdpSocket);
+        if(socket.sendto(packet, server, port) != packet.size()) {
+            return false;
+        }
+        QByteArray buf(MaxUdpPacketSize, Qt::Uninitialized);
+        while(true) {
+            QHostAddress from;
+            quint16 fromPort = 0;
+            qint64 len = socket.recvfrom(buf.data(), buf.size(), &from, &fromPort);
+            if(len < 0) {
+                return false;
+            }
+            // drop the packets from unknown server or with unmatched id and question.
+            if(fromPort != port || !isSameAddress(from, server)) {
+                continue;
+            }
+            if(parseResponse(QByteArray::fromRawData(buf.constData(), static_cast<int>(len)), packet, type, answer)) {
+                break;
+            }
+        }
+        if(answer->truncated) {
+            out.restart();
+            return queryServerTcp(server, packet, type, answer);
+        }
+        return true;
+    } catch(TimeoutException &) {
+        if(!out.expired) {
+            throw;
+        }
+        return false;
+    }
+}
+
+
+bool DnsResolverPrivate::queryServerTcp(const QHostAddress &server, const QByteArray &packet, quint16 type, DnsAnswer *answer)
+{
+    Socket::NetworkLayerProtocol protocol = Socket::IPv4Protocol;
+    if(server.protocol() == QAbstractSocket::IPv6Protocol) {
+        protocol = Socket::IPv6Protocol;
+    }
+    Socket socket(protocol, Socket::TcpSocket);
+    if(!socket.connect(server, port)) {
+        return false;
+    }
+    QByteArray request(2, '\0');
+    qToBigEndian<quint16>(static_cast<quint16>(packet.size()), reinterpret_cast<uchar*>(request.data()));
+    request.append(packet);
+    if(socket.sendall(request) != request.size()) {
+        return false;
+    }
+    const QByteArray &lengthBytes = socket.recvall(2);
+    if(lengthBytes.size() != 2) {
+        return false;
+    }
+    int length = readUInt16(lengthBytes, 0);
+    const QByteArray &response = socket.recvall(length);
+    if(response.size() != length) {
+        return false;
+    }
+    return parseResponse(response, packet, type, answer) && !answer->truncated;
+}
+
+
+// 开始写 DnsResolver 的实现
+DnsResolver::DnsResolver()
+    :d_ptr(new DnsResolverPrivate())
+{
+#ifdef Q_OS_UNIX
+    loadResolvConf();
+    loadHosts();
+#endif
+    Q_D(DnsResolver);
+    if(d->nameServers.isEmpty()) { // the default of resolv.conf
+        d->nameServers.append(QHostAddress(QHostAddress::LocalHost));
+    }
+}
+
+
+DnsResolver::~DnsResolver()
+{
+    delete d_ptr;
+}
+
+
+QList<QHostAddress> DnsResolver::resolve(const QString &hostName, quint32 *ttl)
+{
+    Q_D(DnsResolver);
+    if(ttl) {
+        *ttl = 0;
+    }
+    QHostAddress t;
+    if(t.setAddress(hostName)) {
+        QList<QHostAddress> result;
+        result.append(t);
+        return result;
+    }
+    const QList<QHostAddress> &fromHosts = d->lookupHosts(hostName, 0);
+    if(!fromHosts.isEmpty()) {
+        return fromHosts;
+    }
+
+    QList<QHostAddress> ipv4, ipv6;
+    quint32 ttl4 = 0, ttl6 = 0;
+    {
+        CoroutineGroup operations;
+        operations.spawn([this, hostName, &ipv4, &ttl4] {
+            ipv4 = query(hostName, A, &ttl4);
+        });
+        operations.spawn([this, hostName, &ipv6, &ttl6] {
+            ipv6 = query(hostName, AAAA, &ttl6);
+        });
+        operations.joinall();
+    }
+
+    if(ttl) {
+        if(!ipv4.isEmpty() && !ipv6.isEmpty()) {
+            *ttl = qMin(ttl4, ttl6);
+        } else if(!ipv4.isEmpty()) {
+            *ttl = ttl4;
+        } else if(!ipv6.isEmpty()) {
+            *ttl = ttl6;
+        } else if(ttl4 && ttl6) {
+            *ttl = qMin(ttl4, ttl6);
+        } else {
+            *ttl = qMax(ttl4, ttl6);
+        }
+    }
+    return ipv4 + ipv6;
+}
+
+
+QList<QHostAddress> DnsResolver::query(const QString &hostName, RecordType type, quint32 *ttl)
+{
+    Q_D(DnsResolver);
+    if(ttl) {
+        *ttl = 0;
+    }
+    const QList<QHostAddress> &fromHosts = d->lookupHosts(hostName, type);
+    if(!fromHosts.isEmpty()) {
+        return fromHosts;
+    }
+    foreach(const QString &name, d->candidateNames(hostName)) {
+        const QByteArray &encodedName = encodeName(name);
+        if(encodedName.isEmpty()) {
+            continue;
+        }
+        DnsAnswer answer;
+        if(!d->queryName(encodedName, type, &answer)) {
+            continue;
+        }
+        if(ttl) {
+            *ttl = answer.ttl;
+        }
+        if(!answer.addresses.isEmpty()) {
+            return answer.addresses;
+        }
+    }
+    return QList<QHostAddress>();
+}
+
+
+bool DnsResolver::loadResolvConf(const QString &filePath)
+{
+    Q_D(DnsResolver);
+    QFile f(filePath);
+    if(!f.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QList<QHostAddress> nameServers;
+    QStringList searchDomains;
+    while(!f.atEnd()) {
+        const QString &line = QString::fromUtf8(f.readLine()).trimmed();
+        if(line.isEmpty() || line.startsWith(QLatin1Char('#')) || line.startsWith(QLatin1Char(';'))) {
+            continue;
+        }
+        const QStringList &parts = line.split(QRegExp(QStringLiteral("\\s+")), QString::SkipEmptyParts);
+        if(parts.size() < 2) {
+            continue;
+        }
+        const QString &keyword = parts.at(0);
+        if(keyword == QStringLiteral("nameserver")) {
+            QHostAddress address;
+            if(address.setAddress(parts.at(1))) {
+                nameServers.append(address);
+            }
+        } else if(keyword == QStringLiteral("search")) {
+            searchDomains = parts.mid(1);
+        } else if(keyword == QStringLiteral("domain")) {
+            searchDomains = parts.mid(1, 1);
+        } else if(keyword == QStringLiteral("options")) {
+            foreach(const QString &option, parts.mid(1)) {
+                int colon = option.indexOf(QLatin1Char(':'));
+                if(colon < 0) {
+                    continue;
+                }
+                const QString &name = option.left(colon);
+                bool ok;
+                int value = option.mid(colon + 1).toInt(&ok);
+                if(!ok || value < 0) {
+                    continue;
+                }
+                if(name == QStringLiteral("timeout") && value > 0) {
+                    d->timeout = value * 1000;
+                } else if(name == QStringLiteral("attempts") && value > 0) {
+                    d->attempts = value;
+                } else if(name == QStringLiteral("ndots")) {
+                    d->ndots = value;
+                }
+            }
+        }
+    }
+    if(!nameServers.isEmpty()) {
+        d->nameServers = nameServers;
+    }
+    d->searchDomains = searchDomains;
+    return true;
+}
+
+
+bool DnsResolver::loadHosts(const QString &filePath)
+{
+    QFile f(filePath);
+    if(!f.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    while(!f.atEnd()) {
+        QString line = QString::fromUtf8(f.readLine());
+        int comment = line.indexOf(QLatin1Char('#'));
+        if(comment >= 0) {
+            line.truncate(comment);
+        }
+        const QStringList &parts = line.split(QRegExp(QStringLiteral("\\s+")), QString::SkipEmptyParts);
+        if(parts.size() < 2) {
+            continue;
+        }
+        QHostAddress address;
+        if(!address.setAddress(parts.at(0))) {
+            continue;
+        }
+        for(int i = 1; i < parts.size(); ++i) {
+            addHost(parts.at(i), address);
+        }
+    }
+    return true;
+}
+
+
+void DnsResolver::addHost(const QString &hostName, const QHostAddress &address)
+{
+    Q_D(DnsResolver);
+    QList<QHostAddress> &addresses = d->hosts[hostName.toLower()];
+    if(!addresses.contains(address)) {
+        addresses.append(address);
+    }
+}
+
+
+void DnsResolver::clearHosts()
+{
+    Q_D(DnsResolver);
+    d->hosts.clear();
+}
+
+
+void DnsResolver::setNameServers(const QList<QHostAddress> &nameServers, quint16 port)
+{
+    Q_D(DnsResolver);
+    d->nameServers = nameServers;
+    d->port = port;
+}
+
+
+QList<QHostAddress> DnsResolver::nameServers() const
+{
+    Q_D(const DnsResolver);
+    return d->nameServers;
+}
+
+
+quint16 DnsResolver::nameServerPort() const
+{
+    Q_D(const DnsResolver);
+    return d->port;
+}
+
+
+void DnsResolver::setSearchDomains(const QStringList &searchDomains)
+{
+    Q_D(DnsResolver);
+    d->searchDomains = searchDomains;
+}
+
+
+QStringList DnsResolver::searchDomains() const
+{
+    Q_D(const DnsResolver);
+    return d->searchDomains;
+}
+
+
+void DnsResolver::setTimeout(int msecs)
+{
+    Q_D(DnsResolver);
+    d->timeout = msecs;
+}
+
+
+int DnsResolver::timeout() const
+{
+    Q_D(const DnsResolver);
+    return d->timeout;
+}
+
+
+void DnsResolver::setAttempts(int attempts)
+{
+    Q_D(DnsResolver);
+    d->attempts = qMax(1, attempts);
+}
+
+
+int DnsResolver::attempts() const
+{
+    Q_D(const DnsResolver);
+    return d->attempts;
+}
+
+QTNETWORKNG_NAMESPACE_END
@@ -1,6 +1,8 @@
 #include <QtCore/qdebug.h>
 #include <QtCore/qpointer.h>
-#include "../include/eventloop.h"
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qalgorithms.h>
+#include "../include/eventloop_p.h"
 #include "../include/locks.h"
 #ifdef Q_OS_UNIX
 #include <signal.h>
@@ -208,6 +210,528 @@ ScopedIoWatcher::~ScopedIoWatcher()
     eventLoop->removeWatcher(watcherId);
 }
 
+// 开始写 PersistentIoWatcher 的实现
+
+PersistentIoWatcher::PersistentIoWatcher(EventLoopCoroutine::EventType event)
+    :event(event), functor(0), watcherId(0), fd(-1), waiting(false), resetPending(false)
+{
+}
+
+PersistentIoWatcher::~PersistentIoWatcher()
+{
+    reset();
+}
+
+void PersistentIoWatcher::wait(qintptr fd)
+{
+    EventLoopCoroutine *current = currentLoop().get();
+    if(waiting) {
+        // another coroutine is waiting on the same socket, fall back to a temporary watcher.
+        ScopedIoWatcher watcher(event, fd);
+        watcher.start();
+        return;
+    }
+    if(!watcherId || eventLoop != current || this->fd != fd) {
+        reset();
+        functor = new YieldCurrentFunctor();
+        watcherId = current->createWatcher(event, fd, functor);
+        eventLoop = current;
+        this->fd = fd;
+    }
+    functor->coroutine = BaseCoroutine::current();
+    waiting = true;
+    current->startWatcher(watcherId);
+    try {
+        current->yield();
+    } catch(...) {
+        current->stopWatcher(watcherId);
+        waiting = false;
+        if(resetPending) {
+            reset();
+        }
+        throw;
+    }
+    current->stopWatcher(watcherId);
+    waiting = false;
+    if(resetPending) {
+        reset();
+    }
+}
+
+// removes the watcher in its own event loop, after the socket is handed to another thread.
+struct RemoveWatcherFunctor: public Functor
+{
+    RemoveWatcherFunctor(EventLoopCoroutine *eventLoop, int watcherId)
+        :eventLoop(eventLoop), watcherId(watcherId) {}
+    QPointer<EventLoopCoroutine> eventLoop;
+    int watcherId;
+    virtual void operator()() override
+    {
+        if(!eventLoop.isNull()) {
+            eventLoop->removeWatcher(watcherId);
+        }
+    }
+};
+
+void PersistentIoWatcher::reset()
+{
+    if(waiting) {
+        // the waiting coroutine is woken by triggerIoWatchers(), and removes the watcher after that.
+        resetPending = true;
+        return;
+    }
+    resetPending = false;
+    if(watcherId && !eventLoop.isNull()) {
+        if(eventLoop == currentLoop().get()) {
+            eventLoop->removeWatcher(watcherId);
+        } else {
+            eventLoop->callLaterThreadSafe(0, new RemoveWatcherFunctor(eventLoop, watcherId));
+        }
+    }
+    eventLoop = 0;
+    functor = 0;
+    watcherId = 0;
+    fd = -1;
+}
+
+// 开始实现 TimerWheel
+
+struct MonotonicClock
+{
+    MonotonicClock() { timer.start(); }
+    QElapsedTimer timer;
+};
+
+Q_GLOBAL_STATIC(MonotonicClock, monotonicClock)
+
+qint64 TimerWheel::now()
+{
+    return monotonicClock()->timer.elapsed();
+}
+
+TimerWheel::TimerWheel(int tickMsecs)
+    :heads(SlotCount, -1), bitmap(Levels * SlotsPerLevel / 64, 0), tickMsecs(qMax(tickMsecs, 1))
+    , freeHead(-1), freeTail(-1), freeCount(0), count(0), processing(false)
+{
+    currentTick = now() / this->tickMsecs;
+}
+
+TimerWheel::~TimerWheel()
+{
+    for(const Node &node: nodes) {
+        delete node.callback;
+    }
+}
+
+int TimerWheel::allocate()
+{
+    if(freeCount <= MinFreeNodes && nodes.size() <= IndexMask) {
+        int base = nodes.size();
+        int grow = qMin(qMax(base, 256), IndexMask + 1 - base);
+        nodes.resize(base + grow);
+        for(int i = base; i < base + grow; ++i) {
+            Node &node = nodes[i];
+            node.callback = 0;
+            node.id = i;  // generation 0, bumped to 1 at the first allocation.
+            node.prev = -1;
+            node.next = -1;
+            node.slot = -1;
+            node.firing = 0;
+            node.released = false;
+            if(freeTail < 0) {
+                freeHead = i;
+            } else {
+                nodes[freeTail].next = i;
+            }
+            freeTail = i;
+            ++freeCount;
+        }
+    }
+    if(freeHead < 0) {
+        return -1;
+    }
+    int index = freeHead;
+    Node &node = nodes[index];
+    freeHead = node.next;
+    if(freeHead < 0) {
+        freeTail = -1;
+    }
+    --freeCount;
+    ++count;
+
+    int generation = ((node.id >> IndexBits) + 1) & GenerationMask;
+    if(generation == 0) {
+        generation = 1;  // the id is never zero.
+    }
+    node.id = (generation << IndexBits) | index;
+    node.prev = -1;
+    node.next = -1;
+    node.slot = -1;
+    node.firing = 0;
+    node.released = false;
+    return index;
+}
+
+void TimerWheel::free(int index)
+{
+    Node &node = nodes[index];
+    Functor *callback = node.callback;
+    node.callback = 0;
+    node.slot = -1;
+    node.prev = -1;
+    node.next = -1;
+    node.released = false;
+    if(freeTail < 0) {
+        freeHead = index;
+    } else {
+        nodes[freeTail].next = index;
+    }
+    freeTail = index;
+    ++freeCount;
+    --count;
+    // the callback may cancel other timers while deleted.
+    delete callback;
+}
+
+TimerWheel::Node *TimerWheel::get(int timerId)
+{
+    if(timerId <= 0) {
+        return 0;
+    }
+    int index = timerId & IndexMask;
+    if(index >= nodes.size()) {
+        return 0;
+    }
+    Node *node = &nodes[index];
+    if(node->id != timerId || !node->callback || node->released) {
+        return 0;
+    }
+    return node;
+}
+
+void TimerWheel::link(int index)
+{
+    Node &node = nodes[index];
+    qint64 delta = node.expires - currentTick;
+    int slot;
+    if(delta < 0) {
+        slot = DueSlot;
+    } else if(delta < SlotsPerLevel) {
+        slot = int(node.expires & SlotMask);
+    } else {
+        int level = 1;
+        while(level < Levels - 1 && delta >= (Q_INT64_C(1) << (LevelBits * (level + 1)))) {
+            ++level;
+        }
+        int shift = LevelBits * level;
+        if(delta >= (Q_INT64_C(1) << (LevelBits * Levels))) {
+            // too far away, park it in the farthest slot, it is linked again while cascading.
+            slot = level * SlotsPerLevel + int(((currentTick >> shift) + SlotMask) & SlotMask);
+        } else {
+            slot = level * SlotsPerLevel + int((node.expires >> shift) & SlotMask);
+        }
+    }
+    node.slot = slot;
+    node.prev = -1;
+    node.next = heads.at(slot);
+    if(node.next >= 0) {
+        nodes[node.next].prev = index;
+    }
+    heads[slot] = index;
+    if(slot < DueSlot) {
+        bitmap[slot >> 6] |= Q_UINT64_C(1) << (slot & 63);
+    }
+}
+
+void TimerWheel::unlink(int index)
+{
+    Node &node = nodes[index];
+    int slot = node.slot;
+    if(slot < 0) {
+        return;
+    }
+    if(node.prev >= 0) {
+        nodes[node.prev].next = node.next;
+    } else {
+        heads[slot] = node.next;
+    }
+    if(node.next >= 0) {
+        nodes[node.next].prev = node.prev;
+    }
+    if(heads.at(slot) < 0 && slot < DueSlot) {
+        bitmap[slot >> 6] &= ~(Q_UINT64_C(1) << (slot & 63));
+    }
+    node.slot = -1;
+    node.prev = -1;
+    node.next = -1;
+}
+
+int TimerWheel::findSlot(int level, int from) const
+{
+    for(int slot = from; slot < SlotsPerLevel;) {
+        int bit = level * SlotsPerLevel + slot;
+        quint64 word = bitmap.at(bit >> 6) >> (bit & 63);
+        if(word) {
+            return slot + int(qCountTrailingZeroBits(word));
+        }
+        slot = (slot | 63) + 1;
+    }
+    return SlotsPerLevel;
+}
+
+void TimerWheel::cascade(int level)
+{
+    int slot = level * SlotsPerLevel + int((currentTick >> (LevelBits * level)) & SlotMask);
+    int index = heads.at(slot);
+    heads[slot] = -1;
+    bitmap[slot >> 6] &= ~(Q_UINT64_C(1) << (slot & 63));
+    while(index >= 0) {
+        int next = nodes.at(index).next;
+        link(index);
+        index = next;
+    }
+}
+
+void TimerWheel::run(int slot)
+{
+    // detach the slot first, so timers added by callbacks never join this pass.
+    int index = heads.at(slot);
+    heads[slot] = -1;
+    if(slot < DueSlot) {
+        bitmap[slot >> 6] &= ~(Q_UINT64_C(1) << (slot & 63));
+    }
+    heads[FiringSlot] = index;
+    for(int i = index; i >= 0; i = nodes.at(i).next) {
+        nodes[i].slot = FiringSlot;
+    }
+
+    while(heads.at(FiringSlot) >= 0) {
+        index = heads.at(FiringSlot);
+        unlink(index);
+        Node &node = nodes[index];
+        if(node.interval > 0) {
+            node.expires = qMax(node.expires + node.interval, currentTick);
+            link(index);
+        }
+        ++node.firing;
+        Functor *callback = node.callback;
+        (*callback)();
+        // the callback may add timers and reallocate the nodes.
+        Node &fired = nodes[index];
+        --fired.firing;
+        if((fired.interval == 0 || fired.released) && !fired.firing) {
+            unlink(index);
+            free(index);
+        }
+    }
+}
+
+int TimerWheel::add(int msecs, int interval, Functor *callback)
+{
+    qint64 nowTick = now() / tickMsecs;
+    if(count == 0 && !processing) {
+        currentTick = qMax(currentTick, nowTick);
+    }
+    int index = allocate();
+    if(index < 0) {
+        qWarning("too many timers in the event loop.");
+        delete callback;
+        return 0;
+    }
+    Node &node = nodes[index];
+    node.callback = callback;
+    node.expires = nowTick + (qMax(msecs, 0) + tickMsecs - 1) / tickMsecs;
+    node.interval = interval > 0 ? qMax((interval + tickMsecs - 1) / tickMsecs, 1) : 0;
+    link(index);
+    return node.id;
+}
+
+void TimerWheel::cancel(int timerId)
+{
+    Node *node = get(timerId);
+    if(!node) {
+        return;
+    }
+    int index = timerId & IndexMask;
+    unlink(index);
+    if(node->firing) {
+        node->released = true;
+    } else {
+        free(index);
+    }
+}
+
+qint64 TimerWheel::nextTimeout() const
+{
+    if(count == 0) {
+        return -1;
+    }
+    if(isOccupied(DueSlot)) {
+        return 0;
+    }
+    qint64 next = -1;
+    // level 0 knows the exact tick, the other levels tell when they cascade.
+    int start = int(currentTick & SlotMask);
+    int slot = findSlot(0, start);
+    if(slot < SlotsPerLevel) {
+        next = (currentTick & ~qint64(SlotMask)) + slot;
+    } else {
+        slot = findSlot(0, 0);
+        if(slot < start) {
+            next = (currentTick & ~qint64(SlotMask)) + SlotsPerLevel + slot;
+        }
+    }
+    for(int level = 1; level < Levels; ++level) {
+        int shift = LevelBits * level;
+        qint64 position = currentTick >> shift;
+        bool aligned = (currentTick & ((Q_INT64_C(1) << shift) - 1)) == 0;
+        start = int(position & SlotMask);
+        slot = findSlot(level, aligned ? start : ((start + 1) & SlotMask));
+        if(slot == SlotsPerLevel) {
+            slot = findSlot(level, 0);
+            if(slot == SlotsPerLevel) {
+                continue;
+            }
+        }
+        int distance = (slot - start) & SlotMask;
+        if(distance == 0 && !aligned) {
+            distance = SlotsPerLevel;
+        }
+        qint64 tick = (position + distance) << shift;
+        if(next < 0 || tick < next) {
+            next = tick;
+        }
+    }
+    if(next < 0) {
+        return -1;
+    }
+    return qMax<qint64>(next * tickMsecs - now(), 0);
+}
+
+void TimerWheel::expire()
+{
+    if(processing) {
+        return;
+    }
+    processing = true;
+    qint64 nowTick = now() / tickMsecs;
+    if(isOccupied(DueSlot)) {
+        run(DueSlot);
+    }
+    while(currentTick <= nowTick) {
+        if(count == 0) {
+            currentTick = nowTick + 1;
+            break;
+        }
+        int index = int(currentTick & SlotMask);
+        if(index == 0) {
+            cascade(1);
+            if(((currentTick >> LevelBits) & SlotMask) == 0) {
+                cascade(2);
+                if(((currentTick >> (LevelBits * 2)) & SlotMask) == 0) {
+                    cascade(3);
+                }
+            }
+        }
+        if(!isOccupied(index)) {
+            // skip the empty slots until the next occupied one or the next cascade.
+            qint64 target = (currentTick & ~qint64(SlotMask)) + findSlot(0, index + 1);
+            currentTick = qMin(target, nowTick + 1);
+            continue;
+        }
+        ++currentTick;
+        run(index);
+    }
+    processing = false;
+}
+
+// 开始实现 CallLaterQueue
+
+CallLaterQueue::CallLaterQueue()
+    :head(&stub), tail(&stub), wakeup(0)
+{
+    stub.next.store(0);
+    stub.callback = 0;
+    stub.msecs = 0;
+}
+
+CallLaterQueue::~CallLaterQueue()
+{
+    Item *item;
+    while((item = pop())) {
+        delete item->callback;
+        delete item;
+    }
+}
+
+void CallLaterQueue::pushItem(Item *item)
+{
+    item->next.store(0);
+    Item *prev = head.fetchAndStoreOrdered(item);
+    prev->next.storeRelease(item);
+}
+
+// returns true if the event loop should be woken up.
+bool CallLaterQueue::push(int msecs, Functor *callback)
+{
+    Item *item = new Item;
+    item->callback = callback;
+    item->msecs = msecs;
+    pushItem(item);
+    return wakeup.testAndSetOrdered(0, 1);
+}
+
+CallLaterQueue::Item *CallLaterQueue::pop()
+{
+    Item *item = tail;
+    Item *next = item->next.loadAcquire();
+    if(item == &stub) {
+        if(!next) {
+            return 0;
+        }
+        tail = next;
+        item = next;
+        next = next->next.loadAcquire();
+    }
+    if(next) {
+        tail = next;
+        return item;
+    }
+    if(item != head.loadAcquire()) {
+        // a producer is linking its item, the wakeup comes after it.
+        return 0;
+    }
+    pushItem(&stub);
+    next = item->next.loadAcquire();
+    if(next) {
+        tail = next;
+        return item;
+    }
+    return 0;
+}
+
+// run zero-delay calls in place and turn the others into timers. returns false if some items are left.
+bool CallLaterQueue::drain(EventLoopCoroutinePrivate *loop, int maxItems)
+{
+    wakeup.fetchAndStoreOrdered(0);
+    for(int i = 0; i < maxItems; ++i) {
+        Item *item = pop();
+        if(!item) {
+            return true;
+        }
+        Functor *callback = item->callback;
+        int msecs = item->msecs;
+        delete item;
+        if(msecs > 0) {
+            loop->callLater(msecs, callback);
+        } else {
+            (*callback)();
+            delete callback;
+        }
+    }
+    return false;
+}
+
 // 开始写 CoroutinePrivate 的定义
 
 class CoroutinePrivate: public QObject
@@ -0,0 +1,551 @@
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <QtCore/qvector.h>
+#include <QtCore/qhash.h>
+#include <QtCore/qvarlengtharray.h>
+#include <QtCore/qpointer.h>
+#include <QtCore/qsharedpointer.h>
+#include <QtCore/qdebug.h>
+#include "../include/eventloop_p.h"
+
+QTNETWORKNG_NAMESPACE_BEGIN
+
+// 开始实现 epoll 事件循环
+
+// io watchers live in slots which never move, so a slot can be used while its callback switches coroutines.
+struct EpollWatcher
+{
+    enum Kind {
+        FreeSlot,
+        IoSlot,
+    };
+
+    Functor *callback;
+    qintptr fd;
+    int id;
+    int nextFree;
+    quint32 events;
+    quint16 firing;
+    quint8 kind;
+    bool active;
+    bool released;
+};
+
+
+// an fd is registered once in edge-triggered mode, starting and stopping watchers never calls epoll_ctl().
+struct EpollFd
+{
+    EpollFd()
+        :ready(0), registered(false) {}
+    QVarLengthArray<int, 2> watchers;
+    // events reported while no watcher wanted them, delivered once a watcher starts.
+    quint32 ready;
+    bool registered;
+};
+
+
+class EventLoopCoroutinePrivateEpoll: public EventLoopCoroutinePrivate
+{
+public:
+    EventLoopCoroutinePrivateEpoll(EventLoopCoroutine* parent);
+    virtual ~EventLoopCoroutinePrivateEpoll();
+public:
+    virtual void run() override;
+    virtual int createWatcher(EventLoopCoroutine::EventType event, qintptr fd, Functor *callback) override;
+    virtual void startWatcher(int watcherId) override;
+    virtual void stopWatcher(int watcherId) override;
+    virtual void removeWatcher(int watcherId) override;
+    virtual void triggerIoWatchers(qintptr fd) override;
+    virtual int callLater(int msecs, Functor *callback) override;
+    virtual int callRepeat(int msecs, Functor *callback) override;
+    virtual void cancelCall(int callbackId) override;
+    virtual void callLaterThreadSafe(int msecs, Functor *callback) override;
+    virtual int exitCode() override;
+    virtual bool runUntil(BaseCoroutine *coroutine) override;
+    virtual void yield() override;
+private:
+    EpollWatcher *allocate(EpollWatcher::Kind kind, Functor *callback);
+    void free(EpollWatcher *watcher);
+    EpollWatcher *get(int id, EpollWatcher::Kind kind) const;
+    EpollWatcher *at(int index) const { return chunks.at(index >> ChunkShift) + (index & (ChunkSize - 1)); }
+    int capacity() const { return chunks.size() * ChunkSize; }
+    void fire(EpollWatcher *watcher);
+    void release(EpollWatcher *watcher);
+    void registerFd(qintptr fd, EpollFd &entry);
+    void unregisterFd(qintptr fd);
+    void processEvents();
+    void dispatchIo(qintptr fd, quint32 events);
+    void runPending();
+    void doCallLater();
+    void wakeUp();
+private:
+    enum {
+        ChunkShift = 8,
+        ChunkSize = 1 << ChunkShift,
+        IndexBits = 19,
+        IndexMask = (1 << IndexBits) - 1,
+        GenerationMask = (1 << (31 - IndexBits)) - 1,
+        MinFreeSlots = 4096,
+        MaxEvents = 256,
+    };
+    int epollFd;
+    int wakeupFd;
+    QVector<EpollWatcher*> chunks;
+    int freeHead;
+    int freeTail;
+    int freeCount;
+    QHash<qintptr, EpollFd> fds;
+    TimerWheel timerWheel;
+    QVector<int> pending;
+    CallLaterQueue callLaterQueue;
+    QPointer<BaseCoroutine> loopCoroutine;
+    Q_DECLARE_PUBLIC(EventLoopCoroutine)
+};
+
+
+EventLoopCoroutinePrivateEpoll::EventLoopCoroutinePrivateEpoll(EventLoopCoroutine *parent)
+    :EventLoopCoroutinePrivate(parent), freeHead(-1), freeTail(-1), freeCount(0)
+{
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeupFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(epollFd < 0 || wakeupFd < 0) {
+        qFatal("can not create epoll eventloop.");
+    }
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.u64 = quint64(-1);
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeupFd, &event);
+}
+
+
+EventLoopCoroutinePrivateEpoll::~EventLoopCoroutinePrivateEpoll()
+{
+    for(int i = 0; i < capacity(); ++i) {
+        EpollWatcher *watcher = at(i);
+        if(watcher->kind != EpollWatcher::FreeSlot) {
+            delete watcher->callback;
+        }
+    }
+    for(EpollWatcher *chunk: chunks) {
+        delete[] chunk;
+    }
+    ::close(wakeupFd);
+    ::close(epollFd);
+}
+
+
+EpollWatcher *EventLoopCoroutinePrivateEpoll::allocate(EpollWatcher::Kind kind, Functor *callback)
+{
+    if(freeCount <= MinFreeSlots && capacity() + ChunkSize <= IndexMask + 1) {
+        int base = capacity();
+        EpollWatcher *chunk = new EpollWatcher[ChunkSize];
+        chunks.append(chunk);
+        for(int i = 0; i < ChunkSize; ++i) {
+            EpollWatcher *watcher = chunk + i;
+            watcher->callback = 0;
+            watcher->id = base + i;
+            watcher->nextFree = -1;
+            watcher->kind = EpollWatcher::FreeSlot;
+            if(freeTail < 0) {
+                freeHead = base + i;
+            } else {
+                at(freeTail)->nextFree = base + i;
+            }
+            freeTail = base + i;
+            ++freeCount;
+        }
+    }
+    if(freeHead < 0) {
+        qWarning("too many watchers in the event loop.");
+        return 0;
+    }
+    EpollWatcher *watcher = at(freeHead);
+    freeHead = watcher->nextFree;
+    if(freeHead < 0) {
+        freeTail = -1;
+    }
+    --freeCount;
+
+    int index = watcher->id & IndexMask;
+    int generation = ((watcher->id >> IndexBits) + 1) & GenerationMask;
+    if(generation == 0) {
+        generation = 1;  // the id is never zero.
+    }
+    watcher->id = (generation << IndexBits) | index;
+    watcher->nextFree = -1;
+    watcher->callback = callback;
+    watcher->fd = -1;
+    watcher->events = 0;
+    watcher->firing = 0;
+    watcher->kind = kind;
+    watcher->active = false;
+    watcher->released = false;
+    return watcher;
+}
+
+
+void EventLoopCoroutinePrivateEpoll::free(EpollWatcher *watcher)
+{
+    QHash<qintptr, EpollFd>::iterator itor = fds.find(watcher->fd);
+    if(itor != fds.end()) {
+        int index = watcher->id & IndexMask;
+        for(int i = 0; i < itor->watchers.size(); ++i) {
+            if(itor->watchers.at(i) == index) {
+                itor->watchers.remove(i);
+                break;
+            }
+        }
+        if(itor->watchers.isEmpty()) {
+            unregisterFd(watcher->fd);
+        }
+    }
+    delete watcher->callback;
+    watcher->callback = 0;
+    watcher->kind = EpollWatcher::FreeSlot;
+    int index = watcher->id & IndexMask;
+    if(freeTail < 0) {
+        freeHead = index;
+    } else {
+        at(freeTail)->nextFree = index;
+    }
+    freeTail = index;
+    ++freeCount;
+}
+
+
+EpollWatcher *EventLoopCoroutinePrivateEpoll::get(int id, EpollWatcher::Kind kind) const
+{
+    if(id <= 0) {
+        return 0;
+    }
+    int index = id & IndexMask;
+    if(index >= capacity()) {
+        return 0;
+    }
+    EpollWatcher *watcher = at(index);
+    if(watcher->id != id || watcher->kind != kind || watcher->released) {
+        return 0;
+    }
+    return watcher;
+}
+
+
+void EventLoopCoroutinePrivateEpoll::fire(EpollWatcher *watcher)
+{
+    ++watcher->firing;
+    (*watcher->callback)();
+    --watcher->firing;
+    if(watcher->released && !watcher->firing) {
+        free(watcher);
+    }
+}
+
+
+void EventLoopCoroutinePrivateEpoll::release(EpollWatcher *watcher)
+{
+    if(watcher->firing) {
+        watcher->released = true;
+        watcher->active = false;
+    } else {
+        free(watcher);
+    }
+}
+
+
+void EventLoopCoroutinePrivateEpoll::registerFd(qintptr fd, EpollFd &entry)
+{
+    struct epoll_event event;
+    event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    event.data.u64 = quint64(fd);
+    if(epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        if(errno != EEXIST || epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event) < 0) {
+            qDebug() << "can not add fd to epoll:" << fd << strerror(errno);
+            return;
+        }
+    }
+    entry.registered = true;
+    entry.ready = 0;
+}
+
+
+void EventLoopCoroutinePrivateEpoll::unregisterFd(qintptr fd)
+{
+    QHash<qintptr, EpollFd>::iterator itor = fds.find(fd);
+    if(itor == fds.end()) {
+        return;
+    }
+    if(itor->registered) {
+        // the fd may be closed already, which removes it from epoll as well.
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, 0);
+    }
+    fds.erase(itor);
+}
+
+
+int EventLoopCoroutinePrivateEpoll::createWatcher(EventLoopCoroutine::EventType event, qintptr fd, Functor *callback)
+{
+    EpollWatcher *watcher = allocate(EpollWatcher::IoSlot, callback);
+    if(!watcher) {
+        delete callback;
+        return 0;
+    }
+    watcher->fd = fd;
+    if(event & EventLoopCoroutine::Read)
+        watcher->events |= EPOLLIN;
+    if(event & EventLoopCoroutine::Write)
+        watcher->events |= EPOLLOUT;
+    EpollFd &entry = fds[fd];
+    if(!entry.registered) {
+        registerFd(fd, entry);
+    }
+    entry.watchers.append(watcher->id & IndexMask);
+    return watcher->id;
+}
+
+
+void EventLoopCoroutinePrivateEpoll::startWatcher(int watcherId)
+{
+    EpollWatcher *watcher = get(watcherId, EpollWatcher::IoSlot);
+    if(!watcher || watcher->active) {
+        return;
+    }
+    watcher->active = true;
+    QHash<qintptr, EpollFd>::iterator itor = fds.find(watcher->fd);
+    if(itor != fds.end() && (itor->ready & watcher->events)) {
+        // the edge was reported before, the watcher would never see it again.
+        itor->ready &= ~watcher->events;
+        pending.append(watcherId);
+    }
+}
+
+
+void EventLoopCoroutinePrivateEpoll::stopWatcher(int watcherId)
+{
+    EpollWatcher *watcher = get(watcherId, EpollWatcher::IoSlot);
+    if(watcher) {
+        watcher->active = false;
+    }
+}
+
+
+void EventLoopCoroutinePrivateEpoll::removeWatcher(int watcherId)
+{
+    EpollWatcher *watcher = get(watcherId, EpollWatcher::IoSlot);
+    if(watcher) {
+        release(watcher);
+    }
+}
+
+
+void EventLoopCoroutinePrivateEpoll::triggerIoWatchers(qintptr fd)
+{
+    QHash<qintptr, EpollFd>::iterator itor = fds.find(fd);
+    if(itor == fds.end()) {
+        return;
+    }
+    // called after the fd is closed, so the kernel dropped it from epoll.
+    itor->registered = false;
+    for(int index: itor->watchers) {
+        EpollWatcher *watcher = at(index);
+        if(watcher->active && !watcher->released) {
+            watcher->active = false;
+            pending.append(watcher->id);
+        }
+    }
+}
+
+
+int EventLoopCoroutinePrivateEpoll::callLater(int msecs, Functor *callback)
+{
+    return timerWheel.add(msecs, 0, callback);
+}
+
+
+int EventLoopCoroutinePrivateEpoll::callRepeat(int msecs, Functor *callback)
+{
+    return timerWheel.add(msecs, msecs, callback);
+}
+
+
+void EventLoopCoroutinePrivateEpoll::cancelCall(int callbackId)
+{
+    timerWheel.cancel(callbackId);
+}
+
+
+void EventLoopCoroutinePrivateEpoll::callLaterThreadSafe(int msecs, Functor *callback)
+{
+    if(callLaterQueue.push(msecs, callback)) {
+        wakeUp();
+    }
+}
+
+
+void EventLoopCoroutinePrivateEpoll::wakeUp()
+{
+    quint64 one = 1;
+    ssize_t r;
+    do {
+        r = ::write(wakeupFd, &one, sizeof(one));
+    } while(r < 0 && errno == EINTR);
+}
+
+
+void EventLoopCoroutinePrivateEpoll::doCallLater()
+{
+    quint64 count;
+    ssize_t r;
+    do {
+        r = ::read(wakeupFd, &count, sizeof(count));
+    } while(r < 0 && errno == EINTR);
+    if(!callLaterQueue.drain(this)) {
+        // too many calls for one iteration, leave the rest to the next one.
+        wakeUp();
+    }
+}
+
+
+void EventLoopCoroutinePrivateEpoll::dispatchIo(qintptr fd, quint32 events)
+{
+    QHash<qintptr, EpollFd>::iterator itor = fds.find(fd);
+    if(itor == fds.end()) {
+        return;
+    }
+    quint32 mask = 0;
+    if(events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+        mask |= EPOLLIN;
+    if(events & (EPOLLOUT | EPOLLHUP | EPOLLERR))
+        mask |= EPOLLOUT;
+
+    // callbacks may add or remove watchers of this fd.
+    QVarLengthArray<int, 4> ids;
+    quint32 delivered = 0;
+    for(int index: itor->watchers) {
+        EpollWatcher *watcher = at(index);
+        if(watcher->active && !watcher->released && (watcher->events & mask)) {
+            ids.append(watcher->id);
+            delivered |= watcher->events & mask;
+        }
+    }
+    itor->ready |= mask & ~delivered;
+    for(int id: ids) {
+        EpollWatcher *watcher = get(id, EpollWatcher::IoSlot);
+        if(watcher && watcher->active) {
+            fire(watcher);
+        }
+    }
+}
+
+
+void EventLoopCoroutinePrivateEpoll::runPending()
+{
+    QVector<int> ids;
+    ids.swap(pending);
+    for(int id: ids) {
+        EpollWatcher *watcher = get(id, EpollWatcher::IoSlot);
+        if(watcher) {
+            fire(watcher);
+        }
+    }
+}
+
+
+void EventLoopCoroutinePrivateEpoll::processEvents()
+{
+    int timeout = -1;
+    if(!pending.isEmpty()) {
+        timeout = 0;
+    } else {
+        timeout = int(qMin<qint64>(timerWheel.nextTimeout(), 0x7fffffff));
+    }
+    struct epoll_event events[MaxEvents];
+    int n = epoll_wait(epollFd, events, MaxEvents, timeout);
+    if(n < 0) {
+        if(errno != EINTR) {
+            qWarning() << "epoll_wait() failed:" << strerror(errno);
+        }
+        n = 0;
+    }
+    for(int i = 0; i < n; ++i) {
+        if(events[i].data.u64 == quint64(-1)) {
+            doCallLater();
+        } else {
+            dispatchIo(qintptr(events[i].data.u64), events[i].events);
+        }
+    }
+    runPending();
+    timerWheel.expire();
+}
+
+
+void EventLoopCoroutinePrivateEpoll::run()
+{
+    try {
+        while(true) {
+            processEvents();
+        }
+    } catch(...) {
+        qFatal("epoll eventloop got exception.");
+    }
+}
+
+
+int EventLoopCoroutinePrivateEpoll::exitCode()
+{
+    return 0;
+}
+
+
+bool EventLoopCoroutinePrivateEpoll::runUntil(BaseCoroutine *coroutine)
+{
+    if(!loopCoroutine.isNull()) {
+        QPointer<BaseCoroutine> current = BaseCoroutine::current();
+        std::function<BaseCoroutine*(BaseCoroutine*)> here = [current] (BaseCoroutine *arg) -> BaseCoroutine *  {
+            if(!current.isNull()) {
+                current->yield();
+            }
+            return arg;
+        };
+        coroutine->finished.addCallback(here);
+        loopCoroutine->yield();
+    } else {
+        loopCoroutine = BaseCoroutine::current();
+        QSharedPointer<bool> done(new bool(false));
+        std::function<BaseCoroutine*(BaseCoroutine*)> exitOneDepth = [this, done] (BaseCoroutine *arg) -> BaseCoroutine * {
+            *done = true;
+            if(!loopCoroutine.isNull()) {
+                loopCoroutine->yield();
+            }
+            return arg;
+        };
+        coroutine->finished.addCallback(exitOneDepth);
+        while(!*done) {
+            processEvents();
+        }
+        loopCoroutine.clear();
+    }
+    return true;
+}
+
+
+void EventLoopCoroutinePrivateEpoll::yield()
+{
+    Q_Q(EventLoopCoroutine);
+    if(!loopCoroutine.isNull()) {
+        loopCoroutine->yield();
+    } else {
+       q->BaseCoroutine::yield();
+    }
+}
+
+
+EventLoopCoroutine::EventLoopCoroutine()
+    :BaseCoroutine(BaseCoroutine::current(), 1024 * 1024 * 8), d_ptr(new EventLoopCoroutinePrivateEpoll(this))
+{
+
+}
+
+QTNETWORKNG_NAMESPACE_END
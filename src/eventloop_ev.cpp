@@ -1,94 +1,172 @@
 #include <ev.h>
-#include <QtCore/qmap.h>
-#include <QtCore/qmutex.h>
-#include <QtCore/qqueue.h>
+#include <QtCore/qvector.h>
+#include <QtCore/qhash.h>
+#include <QtCore/qvarlengtharray.h>
 #include <QtCore/qpointer.h>
 #include <QtCore/qdebug.h>
 #include <stddef.h>
-#include "../include/eventloop.h"
+#include "../include/eventloop_p.h"
 
 QTNETWORKNG_NAMESPACE_BEGIN
 
-struct EvWatcher
+// every watcher lives in a slot of a slab. the slots are never moved, so libev can keep pointers
+// to the ev_io, and the watcher id is the slot index tagged with a generation.
+struct EvWatcherSlot
 {
-    virtual ~EvWatcher();
-};
-
-
-EvWatcher::~EvWatcher() {}
+    enum Kind {
+        FreeSlot,
+        IoSlot,
+    };
 
-
-struct IoWatcher: public EvWatcher{
-    IoWatcher(EventLoopCoroutine::EventType event, qintptr fd);
-    virtual ~IoWatcher();
-
-    struct ev_io e;
+    ev_io io;
     Functor *callback;
+    int id;
+    int nextFree;
+    quint16 firing;
+    quint8 kind;
+    bool released;
 };
 
 
-static void ev_io_callback(struct ev_loop *loop, ev_io *w, int revents)
+class EvWatcherTable
 {
-    Q_UNUSED(loop)
-    Q_UNUSED(revents)
-    IoWatcher *watcher = reinterpret_cast<IoWatcher*>(reinterpret_cast<char*>(w) - offsetof(IoWatcher, e));
-    (*watcher->callback)();
-}
+public:
+    EvWatcherTable();
+    ~EvWatcherTable();
+    EvWatcherSlot *allocate(EvWatcherSlot::Kind kind, Functor *callback);
+    void free(EvWatcherSlot *slot);
+    EvWatcherSlot *get(int id, EvWatcherSlot::Kind kind) const;
+    int capacity() const { return chunks.size() * ChunkSize; }
+    EvWatcherSlot *at(int index) const { return chunks.at(index >> ChunkShift) + (index & (ChunkSize - 1)); }
+    static int indexOf(const EvWatcherSlot *slot) { return slot->id & IndexMask; }
+private:
+    void grow();
+private:
+    enum {
+        ChunkShift = 8,
+        ChunkSize = 1 << ChunkShift,
+        IndexBits = 19,
+        IndexMask = (1 << IndexBits) - 1,
+        GenerationMask = (1 << (31 - IndexBits)) - 1,
+        // a freed slot is reused after at least this many other slots, so stale ids hardly match a new watcher.
+        MinFreeSlots = 4096,
+    };
+    QVector<EvWatcherSlot*> chunks;
+    int freeHead;
+    int freeTail;
+    int freeCount;
+};
 
 
-IoWatcher::IoWatcher(EventLoopCoroutine::EventType event, qintptr fd)
+EvWatcherTable::EvWatcherTable()
+    :freeHead(-1), freeTail(-1), freeCount(0)
 {
-    int flags = 0;
-    if(event & EventLoopCoroutine::EventType::Read)
-        flags |= EV_READ;
-    if(event & EventLoopCoroutine::EventType::Write)
-        flags |= EV_WRITE;
-    ev_io_init(&e, ev_io_callback, fd, flags);
 }
 
 
-IoWatcher::~IoWatcher()
+EvWatcherTable::~EvWatcherTable()
 {
-    delete callback;
+    for(int i = 0; i < capacity(); ++i) {
+        EvWatcherSlot *slot = at(i);
+        if(slot->kind != EvWatcherSlot::FreeSlot) {
+            delete slot->callback;
+        }
+    }
+    for(EvWatcherSlot *chunk: chunks) {
+        delete[] chunk;
+    }
 }
 
 
-struct TimerWatcher: public EvWatcher
+void EvWatcherTable::grow()
 {
-    TimerWatcher(int msecs, bool repeat);
-    virtual ~TimerWatcher();
-
-    ev_timer e;
-    Functor *callback;
-};
+    int base = capacity();
+    if(base + ChunkSize > IndexMask + 1) {
+        return;
+    }
+    EvWatcherSlot *chunk = new EvWatcherSlot[ChunkSize];
+    chunks.append(chunk);
+    for(int i = 0; i < ChunkSize; ++i) {
+        EvWatcherSlot *slot = chunk + i;
+        slot->callback = 0;
+        slot->id = base + i;  // generation 0, bumped to 1 at the first allocation.
+        slot->nextFree = -1;
+        slot->firing = 0;
+        slot->kind = EvWatcherSlot::FreeSlot;
+        slot->released = false;
+        if(freeTail < 0) {
+            freeHead = base + i;
+        } else {
+            at(freeTail)->nextFree = base + i;
+        }
+        freeTail = base + i;
+        ++freeCount;
+    }
+}
 
 
-static void ev_timer_callback(struct ev_loop *loop, ev_timer *w, int revents)
+EvWatcherSlot *EvWatcherTable::allocate(EvWatcherSlot::Kind kind, Functor *callback)
 {
-    Q_UNUSED(loop)
-    Q_UNUSED(revents)
-    TimerWatcher *watcher = reinterpret_cast<TimerWatcher*>(reinterpret_cast<char*>(w) - offsetof(TimerWatcher, e));
-    if(!w->repeat) { // ev_timer_again?
-        ev_timer_stop(loop, w);
+    if(freeCount <= MinFreeSlots) {
+        grow();
+    }
+    if(freeHead < 0) {
+        qWarning("too many watchers in the event loop.");
+        return 0;
+    }
+    EvWatcherSlot *slot = at(freeHead);
+    freeHead = slot->nextFree;
+    if(freeHead < 0) {
+        freeTail = -1;
+    }
+    --freeCount;
+
+    int index = slot->id & IndexMask;
+    int generation = ((slot->id >> IndexBits) + 1) & GenerationMask;
+    if(generation == 0) {
+        generation = 1;  // the id is never zero.
     }
-    (*watcher->callback)();
-    // should i remove the wathcer?
+    slot->id = (generation << IndexBits) | index;
+    slot->nextFree = -1;
+    slot->callback = callback;
+    slot->firing = 0;
+    slot->kind = kind;
+    slot->released = false;
+    return slot;
 }
 
 
-TimerWatcher::TimerWatcher(int msecs, bool repeat)
+void EvWatcherTable::free(EvWatcherSlot *slot)
 {
-    float secs = msecs / 1000.0;
-    if(repeat) {
-        ev_timer_init(&e, ev_timer_callback, 0, secs);
+    delete slot->callback;
+    slot->callback = 0;
+    slot->kind = EvWatcherSlot::FreeSlot;
+    slot->released = false;
+    int index = slot->id & IndexMask;
+    if(freeTail < 0) {
+        freeHead = index;
     } else {
-        ev_timer_init(&e, ev_timer_callback, secs, 0);
+        at(freeTail)->nextFree = index;
     }
+    freeTail = index;
+    ++freeCount;
 }
 
-TimerWatcher::~TimerWatcher()
+
+EvWatcherSlot *EvWatcherTable::get(int id, EvWatcherSlot::Kind kind) const
 {
-    delete callback;
+    if(id <= 0) {
+        return 0;
+    }
+    int index = id & IndexMask;
+    if(index >= capacity()) {
+        return 0;
+    }
+    EvWatcherSlot *slot = at(index);
+    if(slot->id != id || slot->kind != kind || slot->released) {
+        return 0;
+    }
+    return slot;
 }
 
 
@@ -112,14 +190,24 @@ public:
     virtual bool runUntil(BaseCoroutine *coroutine) override;
     virtual void yield() override;
     void doCallLater();
+    void fire(EvWatcherSlot *slot);
+    void release(EvWatcherSlot *slot);
+    void freeSlot(EvWatcherSlot *slot);
 private:
     static void ev_async_callback(struct ev_loop *loop, ev_async *w, int revents);
+    static void ev_io_callback(struct ev_loop *loop, ev_io *w, int revents);
+    static void ev_timer_callback(struct ev_loop *loop, ev_timer *w, int revents);
+    void armTimer(qint64 msecs);
 private:
     struct ev_loop *loop;
-    QMap<int, EvWatcher*> watchers;
-    int nextWatcherId;
-    QMutex mqMutex;
-    QQueue<QPair<int, Functor*>> callLaterQueue;
+    EvWatcherTable watchers;
+    // the slots of IO watchers for every fd, so triggerIoWatchers() need not scan the whole table.
+    QHash<qintptr, QVarLengthArray<int, 2>> ioSlots;
+    TimerWheel timerWheel;
+    // one ev_timer for the whole wheel, armed for its next expiry.
+    ev_timer wheelTimer;
+    qint64 wheelDeadline;
+    CallLaterQueue callLaterQueue;
     ev_async asyncContext;
     QAtomicInteger<bool> exitingFlag;
     QPointer<BaseCoroutine> loopCoroutine;
@@ -128,10 +216,13 @@ private:
 };
 
 EventLoopCoroutinePrivateEv::EventLoopCoroutinePrivateEv(EventLoopCoroutine *parent)
-    :EventLoopCoroutinePrivate(parent), loop(0), nextWatcherId(1)
+    :EventLoopCoroutinePrivate(parent), loop(0)
 {
     int flags = EVFLAG_NOENV | EVFLAG_FORKCHECK;
     loop = ev_loop_new(flags);
+    ev_set_userdata(loop, this);
+    ev_init(&wheelTimer, ev_timer_callback);
+    wheelDeadline = -1;
     ev_async_init(&asyncContext, ev_async_callback);
     ev_async_start(loop, &asyncContext);
 }
@@ -141,12 +232,6 @@ EventLoopCoroutinePrivateEv::~EventLoopCoroutinePrivateEv()
 {
     ev_break(loop);
     ev_loop_destroy(loop); // FIXME run() function may not exit, but this situation is rare.
-    QMapIterator<int, EvWatcher*> itor(watchers);
-    while(itor.hasNext())
-    {
-        itor.next();
-        delete itor.value();
-    }
 }
 
 void EventLoopCoroutinePrivateEv::run()
@@ -159,39 +244,125 @@ void EventLoopCoroutinePrivateEv::run()
 }
 
 
+// the watcher is not freed while its callback is running, which usually switches to the coroutine removing it.
+void EventLoopCoroutinePrivateEv::fire(EvWatcherSlot *slot)
+{
+    ++slot->firing;
+    (*slot->callback)();
+    --slot->firing;
+    if(slot->released && !slot->firing) {
+        freeSlot(slot);
+    }
+}
+
+
+void EventLoopCoroutinePrivateEv::release(EvWatcherSlot *slot)
+{
+    ev_io_stop(loop, &slot->io);
+    if(slot->firing) {
+        slot->released = true;
+    } else {
+        freeSlot(slot);
+    }
+}
+
+
+void EventLoopCoroutinePrivateEv::freeSlot(EvWatcherSlot *slot)
+{
+    QHash<qintptr, QVarLengthArray<int, 2>>::iterator itor = ioSlots.find(slot->io.fd);
+    if(itor != ioSlots.end()) {
+        int index = EvWatcherTable::indexOf(slot);
+        for(int i = 0; i < itor->size(); ++i) {
+            if(itor->at(i) == index) {
+                itor->remove(i);
+                break;
+            }
+        }
+        if(itor->isEmpty()) {
+            ioSlots.erase(itor);
+        }
+    }
+    watchers.free(slot);
+}
+
+
+void EventLoopCoroutinePrivateEv::ev_io_callback(struct ev_loop *loop, ev_io *w, int revents)
+{
+    Q_UNUSED(revents)
+    EventLoopCoroutinePrivateEv *d = static_cast<EventLoopCoroutinePrivateEv*>(ev_userdata(loop));
+    d->fire(reinterpret_cast<EvWatcherSlot*>(reinterpret_cast<char*>(w) - offsetof(EvWatcherSlot, io)));
+}
+
+
+void EventLoopCoroutinePrivateEv::ev_timer_callback(struct ev_loop *loop, ev_timer *w, int revents)
+{
+    Q_UNUSED(w)
+    Q_UNUSED(revents)
+    EventLoopCoroutinePrivateEv *d = static_cast<EventLoopCoroutinePrivateEv*>(ev_userdata(loop));
+    d->wheelDeadline = -1;
+    d->timerWheel.expire();
+    d->armTimer(d->timerWheel.nextTimeout());
+}
+
+
+// re-arm the ev_timer only if the wheel wants to wake up earlier than it is armed.
+void EventLoopCoroutinePrivateEv::armTimer(qint64 msecs)
+{
+    if(msecs < 0) {
+        return;
+    }
+    qint64 deadline = TimerWheel::now() + msecs;
+    if(wheelDeadline >= 0 && wheelDeadline <= deadline) {
+        return;
+    }
+    ev_timer_stop(loop, &wheelTimer);
+    ev_timer_set(&wheelTimer, msecs / 1000.0, 0);
+    ev_timer_start(loop, &wheelTimer);
+    wheelDeadline = deadline;
+}
+
+
 int EventLoopCoroutinePrivateEv::createWatcher(EventLoopCoroutine::EventType event, qintptr fd, Functor *callback)
 {
-    IoWatcher *w = new IoWatcher(event, fd);
-    w->callback = callback;
-    watchers.insert(nextWatcherId, w);
-    return nextWatcherId++;
+    EvWatcherSlot *slot = watchers.allocate(EvWatcherSlot::IoSlot, callback);
+    if(!slot) {
+        delete callback;
+        return 0;
+    }
+    int flags = 0;
+    if(event & EventLoopCoroutine::EventType::Read)
+        flags |= EV_READ;
+    if(event & EventLoopCoroutine::EventType::Write)
+        flags |= EV_WRITE;
+    ev_io_init(&slot->io, ev_io_callback, fd, flags);
+    ioSlots[fd].append(EvWatcherTable::indexOf(slot));
+    return slot->id;
 }
 
 
 void EventLoopCoroutinePrivateEv::startWatcher(int watcherId)
 {
-    IoWatcher *w = dynamic_cast<IoWatcher*>(watchers.value(watcherId));
-    if(w) {
-        ev_io_start(loop, &w->e);
+    EvWatcherSlot *slot = watchers.get(watcherId, EvWatcherSlot::IoSlot);
+    if(slot) {
+        ev_io_start(loop, &slot->io);
     }
 }
 
 
 void EventLoopCoroutinePrivateEv::stopWatcher(int watcherId)
 {
-    IoWatcher *w = dynamic_cast<IoWatcher*>(watchers.value(watcherId));
-    if(w) {
-        ev_io_stop(loop, &w->e);
+    EvWatcherSlot *slot = watchers.get(watcherId, EvWatcherSlot::IoSlot);
+    if(slot) {
+        ev_io_stop(loop, &slot->io);
     }
 }
 
 
 void EventLoopCoroutinePrivateEv::removeWatcher(int watcherId)
 {
-    IoWatcher *w = dynamic_cast<IoWatcher*>(watchers.take(watcherId));
-    if(w) {
-        ev_io_stop(loop, &w->e);
-        delete w;
+    EvWatcherSlot *slot = watchers.get(watcherId, EvWatcherSlot::IoSlot);
+    if(slot) {
+        release(slot);
     }
 }
 
@@ -203,9 +374,9 @@ struct TriggerIoWatchersFunctor: public Functor
     EventLoopCoroutinePrivateEv *eventloop;
     virtual void operator()() override
     {
-        IoWatcher *w = dynamic_cast<IoWatcher*>(eventloop->watchers.value(watcherId));
-        if(w) {
-            (*w->callback)();
+        EvWatcherSlot *slot = eventloop->watchers.get(watcherId, EvWatcherSlot::IoSlot);
+        if(slot) {
+            eventloop->fire(slot);
         }
     }
 };
@@ -213,11 +384,15 @@ struct TriggerIoWatchersFunctor: public Functor
 
 void EventLoopCoroutinePrivateEv::triggerIoWatchers(qintptr fd)
 {
-    for(QMap<int, EvWatcher*>::const_iterator itor = watchers.constBegin(); itor != watchers.constEnd(); ++itor) {
-        IoWatcher *w = dynamic_cast<IoWatcher*>(itor.value());
-        if(w && w->e.fd == fd) {
-            ev_io_stop(loop, &w->e);
-            callLater(0, new TriggerIoWatchersFunctor(itor.key(), this));
+    QHash<qintptr, QVarLengthArray<int, 2>>::const_iterator itor = ioSlots.constFind(fd);
+    if(itor == ioSlots.constEnd()) {
+        return;
+    }
+    for(int index: *itor) {
+        EvWatcherSlot *slot = watchers.at(index);
+        if(!slot->released) {
+            ev_io_stop(loop, &slot->io);
+            callLater(0, new TriggerIoWatchersFunctor(slot->id, this));
         }
     }
 }
@@ -225,11 +400,9 @@ void EventLoopCoroutinePrivateEv::triggerIoWatchers(qintptr fd)
 
 int EventLoopCoroutinePrivateEv::callLater(int msecs, Functor *callback)
 {
-    TimerWatcher *w = new TimerWatcher(msecs, false);
-    w->callback = callback;
-    ev_timer_start(loop, &w->e);
-    watchers.insert(nextWatcherId, w);
-    return nextWatcherId++;
+    int timerId = timerWheel.add(msecs, 0, callback);
+    armTimer(qMax(msecs, 0));
+    return timerId;
 }
 
 
@@ -245,19 +418,16 @@ void EventLoopCoroutinePrivateEv::ev_async_callback(struct ev_loop *loop, ev_asy
 
 void EventLoopCoroutinePrivateEv::doCallLater()
 {
-    QMutexLocker locker(&mqMutex);
-    while(!callLaterQueue.isEmpty()) {
-        QPair<int, Functor*> item = callLaterQueue.dequeue();
-        callLater(item.first, item.second);
+    if(!callLaterQueue.drain(this)) {
+        // too many calls for one iteration, leave the rest to the next one.
+        ev_async_send(loop, &asyncContext);
     }
 }
 
 
 void EventLoopCoroutinePrivateEv::callLaterThreadSafe(int msecs, Functor *callback)
 {
-    QMutexLocker locker(&mqMutex);
-    callLaterQueue.enqueue(qMakePair(msecs, callback));
-    if(!ev_async_pending(&asyncContext)) {
+    if(callLaterQueue.push(msecs, callback)) {
         ev_async_send(loop, &asyncContext);
     }
 }
@@ -265,21 +435,16 @@ void EventLoopCoroutinePrivateEv::callLaterThreadSafe(int msecs, Functor *callba
 
 int EventLoopCoroutinePrivateEv::callRepeat(int msecs, Functor *callback)
 {
-    TimerWatcher *w = new TimerWatcher(msecs, true);
-    w->callback = callback;
-    ev_timer_start(loop, &w->e);
-    watchers.insert(nextWatcherId, w);
-    return nextWatcherId++;
+    int timerId = timerWheel.add(msecs, msecs, callback);
+    armTimer(qMax(msecs, 0));
+    return timerId;
 }
 
 
 void EventLoopCoroutinePrivateEv::cancelCall(int callbackId)
 {
-    TimerWatcher *w = dynamic_cast<TimerWatcher*>(watchers.take(callbackId));
-    if(w) {
-        ev_timer_stop(loop, &w->e);
-        delete w;
-    }
+    // the ev_timer stays armed, waking up once for nothing is cheaper than looking for the next timer.
+    timerWheel.cancel(callbackId);
 }
 
 int EventLoopCoroutinePrivateEv::exitCode()
@@ -326,7 +491,7 @@ void EventLoopCoroutinePrivateEv::yield()
 }
 
 EventLoopCoroutine::EventLoopCoroutine()
-    :BaseCoroutine(BaseCoroutine::current()), d_ptr(new EventLoopCoroutinePrivateEv(this))
+    :BaseCoroutine(BaseCoroutine::current(), 1024 * 1024 * 8), d_ptr(new EventLoopCoroutinePrivateEv(this))
 {
 
 }
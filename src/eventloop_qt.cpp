@@ -8,7 +8,7 @@
 #include <QtCore/qpointer.h>
 #include <QtCore/qcoreevent.h>
 
-#include "../include/eventloop.h"
+#include "../include/eventloop_p.h"
 
 QTNETWORKNG_NAMESPACE_BEGIN
 
@@ -43,29 +43,6 @@ IoWatcher::~IoWatcher()
     delete callback;
 }
 
-struct TimerWatcher: public QtWatcher
-{
-    TimerWatcher(int interval, bool singleshot, Functor *callback);
-    virtual ~TimerWatcher();
-
-    int timerId;
-    int interval;
-    bool singleshot;
-    Functor *callback;
-};
-
-TimerWatcher::TimerWatcher(int interval, bool singleshot, Functor *callback)
-    :interval(interval), singleshot(singleshot), callback(callback)
-{
-}
-
-TimerWatcher::~TimerWatcher()
-{
-    if(callback) {
-        delete callback;
-    }
-}
-
 class EventLoopCoroutinePrivateQt: public QObject, EventLoopCoroutinePrivate
 {
     Q_OBJECT
@@ -87,17 +64,26 @@ public:
     virtual bool runUntil(BaseCoroutine *coroutine) override;
     virtual void yield() override;
 private slots:
-    void callLaterThreadSafeStub(int msecs, void* callback)
+    void drainCallLaterQueue()
     {
-        callLater(msecs, reinterpret_cast<Functor*>(callback));
+        if(!callLaterQueue.drain(this)) {
+            // too many calls for one iteration, leave the rest to the next one.
+            QMetaObject::invokeMethod(this, "drainCallLaterQueue", Qt::QueuedConnection);
+        }
     }
 protected:
     virtual void timerEvent(QTimerEvent *event);
 private slots:
     void handleIoEvent(int socket);
+private:
+    void armTimer(qint64 msecs);
 private:
     QMap<int, QtWatcher*> watchers;
-    QMap<int, int> timers;
+    TimerWheel timerWheel;
+    CallLaterQueue callLaterQueue;
+    // one Qt timer for the whole wheel, armed for its next expiry.
+    int wheelTimerId;
+    qint64 wheelDeadline;
     int nextWatcherId;
     int qtExitCode;
     QPointer<BaseCoroutine> loopCoroutine;
@@ -114,7 +100,7 @@ private:
 };
 
 EventLoopCoroutinePrivateQt::EventLoopCoroutinePrivateQt(EventLoopCoroutine *q)
-    :EventLoopCoroutinePrivate(q), nextWatcherId(1)
+    :EventLoopCoroutinePrivate(q), wheelTimerId(0), wheelDeadline(-1), nextWatcherId(1)
 {
     setObjectName("EventLoopCoroutinePrivateQt");
 }
@@ -237,64 +223,60 @@ void EventLoopCoroutinePrivateQt::triggerIoWatchers(qintptr fd)
 
 void EventLoopCoroutinePrivateQt::timerEvent(QTimerEvent *event)
 {
-    if(!timers.contains(event->timerId())) {
+    if(event->timerId() != wheelTimerId) {
         return;
     }
+    killTimer(wheelTimerId);
+    wheelTimerId = 0;
+    wheelDeadline = -1;
+    timerWheel.expire();
+    armTimer(timerWheel.nextTimeout());
+}
 
-    int watcherId = timers.value(event->timerId());
-    TimerWatcher *watcher = dynamic_cast<TimerWatcher*>(watchers.value(watcherId));
 
-    if(!watcher) {
+// restart the Qt timer only if the wheel wants to wake up earlier than it is armed.
+void EventLoopCoroutinePrivateQt::armTimer(qint64 msecs)
+{
+    if(msecs < 0) {
         return;
     }
-
-    bool singleshot = watcher->singleshot;
-    (*watcher->callback)();
-    if(singleshot) {
-        // watcher may be deleted!
-        if(watchers.contains(watcherId)) {
-            watchers.remove(watcherId);
-            timers.remove(event->timerId());
-            killTimer(event->timerId());
-            delete watcher;
-        }
-    } else {
-        //watcher->timerId = startTimer(watcher->interval);
+    qint64 deadline = TimerWheel::now() + msecs;
+    if(wheelTimerId && wheelDeadline <= deadline) {
+        return;
+    }
+    if(wheelTimerId) {
+        killTimer(wheelTimerId);
     }
+    wheelTimerId = startTimer(int(qMin<qint64>(msecs, 0x7fffffff)), Qt::PreciseTimer);
+    wheelDeadline = deadline;
 }
 
 
 int EventLoopCoroutinePrivateQt::callLater(int msecs, Functor *callback)
 {
-    TimerWatcher *w = new TimerWatcher(msecs, true, callback);
-    w->timerId = startTimer(msecs, Qt::CoarseTimer);
-    watchers.insert(nextWatcherId, w);
-    timers.insert(w->timerId, nextWatcherId);
-    return nextWatcherId++;
+    int timerId = timerWheel.add(msecs, 0, callback);
+    armTimer(qMax(msecs, 0));
+    return timerId;
 }
 
 void EventLoopCoroutinePrivateQt::callLaterThreadSafe(int msecs, Functor *callback)
 {
-    QMetaObject::invokeMethod(this, "callLaterThreadSafeStub", Qt::QueuedConnection, Q_ARG(int, msecs), Q_ARG(void*, callback));
+    // only the first call since the last drain posts an event to the loop.
+    if(callLaterQueue.push(msecs, callback)) {
+        QMetaObject::invokeMethod(this, "drainCallLaterQueue", Qt::QueuedConnection);
+    }
 }
 
 int EventLoopCoroutinePrivateQt::callRepeat(int msecs, Functor *callback)
 {
-    TimerWatcher *w = new TimerWatcher(msecs, false, callback);
-    w->timerId = startTimer(msecs);
-    watchers.insert(nextWatcherId, w);
-    timers.insert(w->timerId, nextWatcherId);
-    return nextWatcherId++;
+    int timerId = timerWheel.add(msecs, msecs, callback);
+    armTimer(qMax(msecs, 0));
+    return timerId;
 }
 
 void EventLoopCoroutinePrivateQt::cancelCall(int callbackId)
 {
-    TimerWatcher *w = dynamic_cast<TimerWatcher*>(watchers.take(callbackId));
-    if(w) {
-        timers.remove(w->timerId);
-        killTimer(w->timerId);
-        delete w;
-    }
+    timerWheel.cancel(callbackId);
 }
 
 int EventLoopCoroutinePrivateQt::exitCode()
@@ -343,7 +325,7 @@ void EventLoopCoroutinePrivateQt::yield()
 }
 
 EventLoopCoroutine::EventLoopCoroutine()
-    :BaseCoroutine(BaseCoroutine::current()), d_ptr(new EventLoopCoroutinePrivateQt(this))
+    :BaseCoroutine(BaseCoroutine::current(), 1024 * 1024 * 8), d_ptr(new EventLoopCoroutinePrivateQt(this))
 {
 
 }
@@ -8,6 +8,13 @@
 #ifdef QTNETWOKRNG_USE_SSL
 #include "../include/ssl.h"
 #endif
+#ifdef Q_OS_WIN
+#include <winsock2.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <errno.h>
+#endif
 
 QTNETWORKNG_NAMESPACE_BEGIN
 
@@ -175,47 +182,30 @@ HttpSessionPrivate::~HttpSessionPrivate()
 
 struct HeaderSplitter
 {
-    QSharedPointer<SocketLike> connection;
-    QByteArray buf;
+    SocketBuffer buf;
 
     HeaderSplitter(QSharedPointer<SocketLike> connection)
-        :connection(connection) {}
+        :buf(connection) {}
 
     QByteArray nextLine()
     {
-        const int MaxLineLength = 1024;
-        QByteArray line;
-        bool expectingLineBreak = false;
-
-        for(int i = 0; i < MaxLineLength; ++i) {
-            if(buf.isEmpty()) {
-                buf = connection->recv(1024);
-                if(buf.isEmpty()) {
-                    return QByteArray();
-                }
-            }
-            int j = 0;
-            for(; j < buf.size() && j < MaxLineLength; ++j) {
-                char c = buf.at(j);
-                if(c == '\n') {
-                    if(!expectingLineBreak) {
-                        throw InvalidHeader();
-                    }
-                    buf.remove(0, j + 1);
-                    return line;
-                } else if(c == '\r') {
-                    if(expectingLineBreak) {
-                        throw InvalidHeader();
-                    }
-                    expectingLineBreak = true;
-                } else {
-                    line.append(c);
-                }
+        const int MaxLineLength = 1024 * 64;
+        QByteArray line = buf.readLine(MaxLineLength);
+        if(line.isEmpty()) {
+            if(buf.size() >= MaxLineLength) {
+                qDebug() << "exhaused max line length.";
+                throw InvalidHeader();
             }
-            buf.remove(0, j + 1);
+            return QByteArray();
         }
-        qDebug() << "exhaused max lines.";
-        throw InvalidHeader();
+        if(line.size() < 2 || line.at(line.size() - 2) != '\r') {
+            throw InvalidHeader();
+        }
+        line.chop(2);
+        if(line.contains('\r')) {
+            throw InvalidHeader();
+        }
+        return line;
     }
 };
 
@@ -247,10 +237,33 @@ static QUrl hostOnly(const QUrl &url)
     return h;
 }
 
+// an idle keep-alive connection must not be readable. if it is, the server either closed it (EOF/RST)
+// or sent some garbage that we can not match to any request. the socket is always non-blocking.
+static bool isIdleConnectionAlive(QSharedPointer<SocketLike> connection)
+{
+    if(connection.isNull() || !connection->isValid()) {
+        return false;
+    }
+    char c;
+#ifdef Q_OS_WIN
+    int result = ::recv(static_cast<SOCKET>(connection->fileno()), &c, 1, MSG_PEEK);
+    return result < 0 && WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    ssize_t result;
+    do {
+        result = ::recv(static_cast<int>(connection->fileno()), &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    } while(result < 0 && errno == EINTR);
+    return result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+#endif
+}
+
 ConnectionPool::ConnectionPool()
-    :maxConnectionsPerServer(10), timeToLive(60 * 5), operations(new CoroutineGroup), proxySwitcher(new SimpleProxySwitcher)
+    :maxConnectionsPerServer(10), timeToLive(60 * 5), tcpFastOpen(false), operations(new CoroutineGroup), proxySwitcher(new SimpleProxySwitcher)
 {
     operations->spawnWithName("removeUnusedConnections", [this] {removeUnusedConnections();});
+#ifdef QTNETWOKRNG_USE_SSL
+    sslSessionCache.reset(new SslSessionCache());
+#endif
 }
 
 ConnectionPool::~ConnectionPool()
@@ -260,28 +273,75 @@ ConnectionPool::~ConnectionPool()
 
 void ConnectionPool::recycle(const QUrl &url, QSharedPointer<SocketLike> connection)
 {
+    if(connection.isNull() || !connection->isValid()) {
+        return;
+    }
     const QUrl &h = hostOnly(url);
     ConnectionPoolItem &item = items[h];
-    item.lastUsed = QDateTime::currentDateTimeUtc();
+    const QDateTime &now = QDateTime::currentDateTimeUtc();
+    item.lastUsed = now;
     if(item.semaphore.isNull()) {
         item.semaphore.reset(new Semaphore(maxConnectionsPerServer));
     }
     if(item.connections.size() < maxConnectionsPerServer) {
-        item.connections.insert(connection);
+        IdleConnection idle;
+        idle.connection = connection;
+        idle.lastUsed = now;
+        item.connections.append(idle);
+    } else {
+        connection->close();
     }
 }
 
-QSharedPointer<SocketLike> ConnectionPool::connectionForUrl(const QUrl &url)
+QSharedPointer<SocketLike> ConnectionPool::takeIdleConnection(const QUrl &url)
 {
     const QUrl &h = hostOnly(url);
+    if(!items.contains(h)) {
+        return QSharedPointer<SocketLike>();
+    }
     ConnectionPoolItem &item = items[h];
+    const QDateTime &now = QDateTime::currentDateTimeUtc();
+    // the most recently used connection is the most likely one to be kept by server.
+    while(!item.connections.isEmpty()) {
+        const IdleConnection idle = item.connections.takeLast();
+        if(idle.lastUsed.secsTo(now) >= timeToLive || !isIdleConnectionAlive(idle.connection)) {
+            idle.connection->close();
+            continue;
+        }
+        item.lastUsed = now;
+        return idle.connection;
+    }
+    return QSharedPointer<SocketLike>();
+}
 
-    item.lastUsed = QDateTime::currentDateTimeUtc();
-    if(item.semaphore.isNull()) {
-        item.semaphore.reset(new Semaphore(maxConnectionsPerServer));
+QSharedPointer<SocketLike> ConnectionPool::connectionForUrl(const QUrl &url)
+{
+    QSharedPointer<SocketLike> connection = takeIdleConnection(url);
+    if(!connection.isNull()) {
+        return connection;
+    }
+    return newConnectionForUrl(url);
+}
+
+// if `firstBytesSent` is not null, `firstBytes` may be sent in SYN by TCP Fast Open, and `firstBytesSent` tells whether it is sent.
+QSharedPointer<SocketLike> ConnectionPool::newConnectionForUrl(const QUrl &url, const QByteArray &firstBytes, bool *firstBytesSent)
+{
+    if(firstBytesSent) {
+        *firstBytesSent = false;
+    }
+    QSharedPointer<Semaphore> semaphore;
+    {
+        const QUrl &h = hostOnly(url);
+        ConnectionPoolItem &item = items[h];
+        item.lastUsed = QDateTime::currentDateTimeUtc();
+        if(item.semaphore.isNull()) {
+            item.semaphore.reset(new Semaphore(maxConnectionsPerServer));
+        }
+        // do not hold the reference of item, removeUnusedConnections() may remove it while we are connecting.
+        semaphore = item.semaphore;
     }
 
-    ScopedLock<Semaphore> lock(*item.semaphore);Q_UNUSED(lock);
+    ScopedLock<Semaphore> lock(*semaphore);Q_UNUSED(lock);
 
     QSharedPointer<Socket> rawSocket;
     int defaultPort = 80;
@@ -296,6 +356,10 @@ QSharedPointer<SocketLike> ConnectionPool::connectionForUrl(const QUrl &url)
     }
 
     QSharedPointer<SocketLike> connection;
+#ifdef QTNETWOKRNG_USE_SSL
+    // tls sessions are resumed per origin, whatever proxy is used.
+    const QString &sessionKey = url.host() + QLatin1Char(':') + QString::number(url.port(defaultPort));
+#endif
 
     QSharedPointer<Socks5Proxy> socks5Proxy = proxySwitcher->selectSocks5Proxy(url);
     if(socks5Proxy) {
@@ -305,7 +369,8 @@ QSharedPointer<SocketLike> ConnectionPool::connectionForUrl(const QUrl &url)
         } else{
     #ifdef QTNETWOKRNG_USE_SSL
             QSharedPointer<SslSocket> ssl(new SslSocket(rawSocket));
-            ssl->handshake(false);
+            ssl->setSessionCache(sslSessionCache, sessionKey);
+            ssl->handshake(false, url.host());
             connection = SocketLike::sslSocket(ssl);
     #else
             qDebug() << "invalid scheme";
@@ -320,13 +385,21 @@ QSharedPointer<SocketLike> ConnectionPool::connectionForUrl(const QUrl &url)
             connection = SocketLike::rawSocket(rawSocket);
         } else{
     #ifdef QTNETWOKRNG_USE_SSL
-            connection = SocketLike::sslSocket(QSharedPointer<SslSocket>::create(rawSocket));
+            QSharedPointer<SslSocket> ssl(new SslSocket(rawSocket));
+            ssl->setSessionCache(sslSessionCache, sessionKey);
+            connection = SocketLike::sslSocket(ssl);
     #else
             qDebug() << "invalid scheme";
             throw ConnectionError();
     #endif
         }
-        if(!connection->connect(url.host(), url.port(defaultPort))) {
+        if(firstBytesSent && tcpFastOpen && url.scheme() == QStringLiteral("http") && !firstBytes.isEmpty()) {
+            if(rawSocket->connectAndSend(url.host(), url.port(defaultPort), firstBytes) != firstBytes.size()) {
+                qDebug() << "can not connect to host: " << url.host() << connection->errorString();
+                throw ConnectionError();
+            }
+            *firstBytesSent = true;
+        } else if(!connection->connect(url.host(), url.port(defaultPort))) {
             qDebug() << "can not connect to host: " << url.host() << connection->errorString();
             throw ConnectionError();
         }
@@ -339,15 +412,23 @@ QSharedPointer<SocketLike> ConnectionPool::connectionForUrl(const QUrl &url)
 void ConnectionPool::removeUnusedConnections()
 {
     while(true) {
-        const QDateTime &now = QDateTime::currentDateTimeUtc();
         Coroutine::sleep(1);
-        QMap<QUrl, ConnectionPoolItem> newItems;
-        for(QMap<QUrl, ConnectionPoolItem>::const_iterator itor = items.constBegin(); itor != items.constEnd(); ++itor) {
-            if(itor.value().lastUsed.secsTo(now) < timeToLive) {
-                newItems.insert(itor.key(), itor.value());
+        const QDateTime &now = QDateTime::currentDateTimeUtc();
+        QMutableMapIterator<QUrl, ConnectionPoolItem> itor(items);
+        while(itor.hasNext()) {
+            ConnectionPoolItem &item = itor.next().value();
+            QMutableListIterator<IdleConnection> connectionItor(item.connections);
+            while(connectionItor.hasNext()) {
+                const IdleConnection &idle = connectionItor.next();
+                if(idle.lastUsed.secsTo(now) >= timeToLive) {
+                    idle.connection->close();
+                    connectionItor.remove();
+                }
+            }
+            if(item.connections.isEmpty() && item.lastUsed.secsTo(now) >= timeToLive) {
+                itor.remove();
             }
         }
-        items = newItems;
     }
 }
 
@@ -385,48 +466,25 @@ void ConnectionPool::setHttpProxy(QSharedPointer<HttpProxy> proxy)
 
 struct ChunkedBlockReader
 {
-    QSharedPointer<SocketLike> connection;
-    QByteArray buf;
+    SocketBuffer &buf;
     int debugLevel;
 
-    ChunkedBlockReader(QSharedPointer<SocketLike> connection)
-        :connection(connection), debugLevel(0) {}
+    ChunkedBlockReader(SocketBuffer &buf)
+        :buf(buf), debugLevel(0) {}
 
     QByteArray nextBlock(qint64 leftBytes)
     {
         const int MaxLineLength = 6; // ffff\r\n
-        QByteArray numBytes;
-        bool expectingLineBreak = false;
-        if(buf.size() < MaxLineLength) {
-            buf.append(connection->recv(1024 * 8));
-            if(buf.size() < 3) { // 0\r\n
-                throw ChunkedEncodingError();
-            }
-        }
-
-        bool ok = false;
-        for(int i = 0; i < buf.size() && i < MaxLineLength; ++i) {
-            char c = buf.at(i);
-            if(c == '\n') {
-                if(!expectingLineBreak) {
-                    throw ChunkedEncodingError();
-                }
-                buf.remove(0, i + 1);
-                ok = true;
-                break;
-            } else if(c == '\r') {
-                if(expectingLineBreak) {
-                    throw ChunkedEncodingError();
-                }
-                expectingLineBreak = true;
-            } else {
-                numBytes.append(c);
-            }
+        QByteArray numBytes = buf.readLine(MaxLineLength);
+        if(numBytes.size() < 3 || numBytes.at(numBytes.size() - 2) != '\r') { // 0\r\n
+            throw ChunkedEncodingError();
         }
-        if(!ok) {
+        numBytes.chop(2);
+        if(numBytes.contains('\r')) {
             throw ChunkedEncodingError();
         }
 
+        bool ok = false;
         qint64 bytesToRead = numBytes.toUInt(&ok, 16);
         if(!ok) {
             if(debugLevel > 0) {
@@ -439,16 +497,12 @@ struct ChunkedBlockReader
             throw UnrewindableBodyError();
         }
 
-        while(buf.size() < bytesToRead + 2) {
-            const QByteArray t = connection->recv(1024 * 8);
-            if(t.isEmpty()) {
-                throw ConnectionError();
-            }
-            buf.append(t);
+        if(!buf.fill(static_cast<int>(bytesToRead) + 2)) {
+            throw ConnectionError();
         }
 
-        const QByteArray &result = buf.mid(0, bytesToRead);
-        buf.remove(0, bytesToRead + 2);
+        const QByteArray &result = buf.read(static_cast<int>(bytesToRead));
+        buf.consume(2);
 
         if(bytesToRead == 0 && !buf.isEmpty() && debugLevel > 0) {
             qDebug() << "bytesToRead == 0 but some bytes left.";
@@ -459,6 +513,42 @@ struct ChunkedBlockReader
 
 };
 
+static bool hasConnectionToken(const QByteArray &connectionHeader, const QByteArray &token)
+{
+    foreach(const QByteArray &value, connectionHeader.split(',')) {
+        if(value.trimmed().toLower() == token) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// see rfc7230 section 6.3
+static bool isKeepAlive(const HttpRequest &request, const HttpResponse &response)
+{
+    const QByteArray &requestConnection = request.header(QStringLiteral("Connection"));
+    if(hasConnectionToken(requestConnection, "close")) {
+        return false;
+    }
+    const QByteArray &responseConnection = response.header(QStringLiteral("Connection"));
+    if(hasConnectionToken(responseConnection, "close")) {
+        return false;
+    }
+    if(response.version == Http1_0 || request.version == Http1_0) {
+        return hasConnectionToken(responseConnection, "keep-alive");
+    }
+    return response.version == Http1_1;
+}
+
+// see rfc7230 section 3.3.3
+static bool hasResponseBody(const HttpRequest &request, const HttpResponse &response)
+{
+    if(request.method.toUpper() == QStringLiteral("HEAD")) {
+        return false;
+    }
+    return !((response.statusCode >= 100 && response.statusCode < 200) || response.statusCode == 204 || response.statusCode == 304);
+}
+
 HttpResponse HttpSessionPrivate::send(HttpRequest &request)
 {
     QUrl &url = request.url;
@@ -477,8 +567,6 @@ HttpResponse HttpSessionPrivate::send(HttpRequest &request)
     mergeCookies(request, url);
     QList<HttpHeader> allHeaders = makeHeaders(request, url);
 
-    QSharedPointer<SocketLike> connection = connectionForUrl(url);
-
     if(request.version == HttpVersion::Unknown) {
         request.version = defaultVersion;
     }
@@ -506,23 +594,62 @@ HttpResponse HttpSessionPrivate::send(HttpRequest &request)
     if(debugLevel > 0) {
         qDebug() << "sending headers:" << lines.join();
     }
-    connection->sendall(lines.join());
-
+    if(debugLevel > 1 && !request.body.isEmpty()) {
+        qDebug() << "sending body:" << request.body;
+    }
+    // the request line, headers and body are written together by one writev() without joining them.
+    qint64 messageSize = 0;
+    for(const QByteArray &line: lines) {
+        messageSize += line.size();
+    }
     if(!request.body.isEmpty()) {
-        if(debugLevel > 1) {
-            qDebug() << "sending body:" << request.body;
+        lines.append(request.body);
+        messageSize += request.body.size();
+    }
+
+    // an idle connection may be closed by server at any time before our request arrives.
+    // in that case, we retry with a newly created connection only once. but the server may have
+    // processed the request before closing, so a sent request is retried only if it is idempotent.
+    const QString &method = request.method.toUpper();
+    bool safe = method == QStringLiteral("GET") || method == QStringLiteral("HEAD") || method == QStringLiteral("OPTIONS");
+    bool idempotent = safe || method == QStringLiteral("PUT") || method == QStringLiteral("DELETE");
+    QSharedPointer<SocketLike> connection = takeIdleConnection(url);
+    bool reused = !connection.isNull();
+    bool sent = false;
+    if(!reused) {
+        // TCP Fast Open may deliver the request twice, so it is used for the safe methods only.
+        if(tcpFastOpen && safe) {
+            connection = newConnectionForUrl(url, lines.join(), &sent);
+        } else {
+            connection = newConnectionForUrl(url);
+        }
+    }
+    QByteArray firstLine;
+    HeaderSplitter splitter(connection);
+    while(true) {
+        if(!sent) {
+            sent = connection->sendv(lines) == messageSize;
+        }
+        if(sent) {
+            firstLine = splitter.nextLine();
+        }
+        if(!firstLine.isEmpty() || !reused || (sent && !idempotent)) {
+            break;
+        }
+        if(debugLevel > 0) {
+            qDebug() << "idle connection was closed by server, try again with a new connection.";
         }
-        connection->sendall(request.body);
+        connection->close();
+        connection = newConnectionForUrl(url);
+        splitter = HeaderSplitter(connection);
+        reused = false;
+        sent = false;
     }
 
     HttpResponse response;
     response.request = request;
     response.url = request.url;
 
-    HeaderSplitter splitter(connection);
-
-    QByteArray firstLine = splitter.nextLine();
-
     QList<QByteArray> commands = splitBytes(firstLine, ' ', 2);
     if(commands.size() != 3) {
         throw InvalidHeader();
@@ -569,33 +696,42 @@ HttpResponse HttpSessionPrivate::send(HttpRequest &request)
         cookieJar.setCookiesFromUrl(response.cookies, response.url);
     }
 
-    if(!splitter.buf.isEmpty()) {
-        response.body = splitter.buf;
-    }
+    // the connection can be reused only if the end of response body is determined by the response itself.
+    bool keepAlive = isKeepAlive(request, response);
 
     qint64 contentLength = response.getContentLength();
-    if(contentLength > 0) {
+    if(!hasResponseBody(request, response)) {
+        if(!splitter.buf.isEmpty()) {
+            keepAlive = false;
+            splitter.buf.clear();
+        }
+    } else if(contentLength > 0) {
         if(contentLength > request.maxBodySize) {
             throw UnrewindableBodyError();
         } else {
-            while(response.body.size() < contentLength) {
-                qint64 leftBytes = qMin((qint64) 1024 * 8, contentLength - response.body.size());
-                const QByteArray &t = connection->recvall(leftBytes);
-                if(t.isEmpty()) {
+            // the rest of body is received into the response directly.
+            response.body = splitter.buf.read(static_cast<int>(contentLength));
+            if(!splitter.buf.isEmpty()) {
+                keepAlive = false;
+                splitter.buf.clear();
+            }
+            qint64 received = response.body.size();
+            response.body.resize(static_cast<int>(contentLength));
+            while(received < contentLength) {
+                qint64 bytes = connection->recv(response.body.data() + received, contentLength - received);
+                if(bytes <= 0) {
                     qDebug() << "no content!";
                     throw ConnectionError();
                 }
-                response.body.append(t);
+                received += bytes;
             }
         }
     } else if(contentLength < 0) { // without `Content-Length` header.
         const QByteArray &transferEncodingHeader = response.header(QStringLiteral("Transfer-Encoding"));
         bool readTrunked = (transferEncodingHeader.toLower() == QByteArray("chunked"));
         if(readTrunked) {
-            ChunkedBlockReader reader(connection);
-            reader.buf = response.body;
+            ChunkedBlockReader reader(splitter.buf);
             reader.debugLevel = debugLevel;
-            response.body.clear();
             while(true) {
                 qint64 leftBytes = request.maxBodySize - response.body.size();
                 const QByteArray &block = reader.nextBlock(leftBytes);
@@ -604,7 +740,12 @@ HttpResponse HttpSessionPrivate::send(HttpRequest &request)
                 }
                 response.body.append(block);
             }
+            if(!splitter.buf.isEmpty()) {
+                keepAlive = false;
+            }
         } else {
+            keepAlive = false; // the body is ended by closing connection.
+            response.body = splitter.buf.readAll();
             while(response.body.size() < request.maxBodySize) {
                 const QByteArray &t = connection->recvall(1024 * 8);
                 if(t.isEmpty()) {
@@ -614,8 +755,9 @@ HttpResponse HttpSessionPrivate::send(HttpRequest &request)
             }
         }
     } else { // nothing to read. empty document.
-        if(!response.body.isEmpty()) {
-            // warning!
+        if(!splitter.buf.isEmpty()) {
+            keepAlive = false;
+            splitter.buf.clear();
         }
     }
     const QByteArray &contentEncodingHeader = response.header("Content-Encoding");
@@ -629,7 +771,11 @@ HttpResponse HttpSessionPrivate::send(HttpRequest &request)
     if(debugLevel > 1 && !response.body.isEmpty()) {
         qDebug() << "receiving body:" << response.body;
     }
-    recycle(response.url, connection);
+    if(keepAlive) {
+        recycle(url, connection);
+    } else {
+        connection->close();
+    }
     return response;
 }
 
@@ -896,6 +1042,18 @@ int HttpSession::maxConnectionsPerServer()
     return d->maxConnectionsPerServer;
 }
 
+void HttpSession::setTcpFastOpen(bool enabled)
+{
+    Q_D(HttpSession);
+    d->tcpFastOpen = enabled;
+}
+
+bool HttpSession::tcpFastOpen() const
+{
+    Q_D(const HttpSession);
+    return d->tcpFastOpen;
+}
+
 
 void HttpSession::setDebugLevel(int level)
 {
@@ -0,0 +1,636 @@
+#include <QtCore/qthread.h>
+#include <QtCore/qsemaphore.h>
+#include <QtCore/qvector.h>
+#include <QtCore/qreadwritelock.h>
+#include "../include/loop_pool.h"
+#include "../include/coroutine_utils.h"
+#include "../include/socket_utils.h"
+
+QTNETWORKNG_NAMESPACE_BEGIN
+
+// 开始实现 LoopPool
+
+class LoopThread: public QThread
+{
+public:
+    LoopThread();
+    virtual void run();
+public:
+    QSemaphore ready;
+    QAtomicInt load;
+    EventLoopCoroutine *loop;
+    CoroutineGroup *operations;   // only touched by the thread itself.
+    Event *stopEvent;             // only touched by the thread itself.
+};
+
+
+LoopThread::LoopThread()
+    :loop(0), operations(0), stopEvent(0)
+{
+}
+
+
+void LoopThread::run()
+{
+    loop = EventLoopCoroutine::get();
+    CoroutineGroup operations;
+    Event stopEvent;
+    this->operations = &operations;
+    this->stopEvent = &stopEvent;
+    ready.release();
+    stopEvent.wait();
+    this->operations = 0;
+    this->stopEvent = 0;
+    operations.killall();
+}
+
+
+struct LoadGuard
+{
+    LoadGuard(QAtomicInt *load)
+        :load(load) {}
+    ~LoadGuard() { load->deref(); }
+    QAtomicInt *load;
+};
+
+
+class LoopPoolPrivate
+{
+public:
+    LoopPoolPrivate(int size);
+    ~LoopPoolPrivate();
+public:
+    int choose();
+    bool spawnOn(int index, const std::function<void()> &func);
+    void stop();
+public:
+    QVector<LoopThread*> threads;
+    QAtomicInt next;
+    LoopPool::PlacementPolicy policy;
+    // spawnOn() may run in any thread. it holds the read lock while posting to a loop,
+    // so stop() never destroys the loops under an in-flight spawnOn().
+    QReadWriteLock stopLock;
+    QAtomicInt stopped;
+};
+
+
+LoopPoolPrivate::LoopPoolPrivate(int size)
+    :policy(LoopPool::RoundRobin), stopped(0)
+{
+    if(size <= 0) {
+        size = qMax(QThread::idealThreadCount(), 1);
+    }
+    for(int i = 0; i < size; ++i) {
+        LoopThread *thread = new LoopThread();
+        thread->setObjectName(QStringLiteral("LoopPool-%1").arg(i));
+        thread->start();
+        threads.append(thread);
+    }
+    // wait until every thread has published its event loop.
+    for(LoopThread *thread: threads) {
+        thread->ready.acquire();
+    }
+}
+
+
+LoopPoolPrivate::~LoopPoolPrivate()
+{
+    stop();
+    qDeleteAll(threads);
+}
+
+
+int LoopPoolPrivate::choose()
+{
+    int size = threads.size();
+    int start = static_cast<int>(static_cast<uint>(next.fetchAndAddRelaxed(1)) % static_cast<uint>(size));
+    if(policy == LoopPool::RoundRobin) {
+        return start;
+    }
+    // start from the round-robin position, so idle loops are used in turns.
+    int best = start;
+    int bestLoad = threads.at(start)->load.load();
+    for(int i = 1; i < size && bestLoad > 0; ++i) {
+        int index = (start + i) % size;
+        int load = threads.at(index)->load.load();
+        if(load < bestLoad) {
+            best = index;
+            bestLoad = load;
+        }
+    }
+    return best;
+}
+
+
+bool LoopPoolPrivate::spawnOn(int index, const std::function<void()> &func)
+{
+    if(index < 0 || index >= threads.size()) {
+        return false;
+    }
+    QReadLocker locker(&stopLock);
+    if(stopped.load()) {
+        return false;
+    }
+    LoopThread *thread = threads.at(index);
+    QAtomicInt *load = &thread->load;
+    load->ref();
+    std::function<void()> wrapper = [load, func] {
+        LoadGuard guard(load);
+        func();
+    };
+    thread->loop->callLaterThreadSafe(0, new LambdaFunctor([thread, load, wrapper] {
+        if(thread->operations) {
+            thread->operations->spawn(wrapper);
+        } else {
+            load->deref();
+        }
+    }));
+    return true;
+}
+
+
+void LoopPoolPrivate::stop()
+{
+    {
+        QWriteLocker locker(&stopLock);
+        if(!stopped.testAndSetOrdered(0, 1)) {
+            return;
+        }
+        for(LoopThread *thread: threads) {
+            thread->loop->callLaterThreadSafe(0, new LambdaFunctor([thread] {
+                if(thread->stopEvent) {
+                    thread->stopEvent->set();
+                }
+            }));
+        }
+    }
+    for(LoopThread *thread: threads) {
+        thread->wait();
+    }
+}
+
+
+LoopPool::LoopPool(int size)
+    :d_ptr(new LoopPoolPrivate(size))
+{
+}
+
+
+LoopPool::~LoopPool()
+{
+    delete d_ptr;
+}
+
+
+int LoopPool::size() const
+{
+    Q_D(const LoopPool);
+    return d->threads.size();
+}
+
+
+EventLoopCoroutine *LoopPool::loop(int index) const
+{
+    Q_D(const LoopPool);
+    if(d->stopped.load() || index < 0 || index >= d->threads.size()) {
+        return 0;
+    }
+    return d->threads.at(index)->loop;
+}
+
+
+int LoopPool::load(int index) const
+{
+    Q_D(const LoopPool);
+    if(index < 0 || index >= d->threads.size()) {
+        return 0;
+    }
+    return d->threads.at(index)->load.load();
+}
+
+
+int LoopPool::indexOf(EventLoopCoroutine *loop) const
+{
+    Q_D(const LoopPool);
+    for(int i = 0; i < d->threads.size(); ++i) {
+        if(d->threads.at(i)->loop == loop) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+void LoopPool::setPlacementPolicy(LoopPool::PlacementPolicy policy)
+{
+    Q_D(LoopPool);
+    d->policy = policy;
+}
+
+
+LoopPool::PlacementPolicy LoopPool::placementPolicy() const
+{
+    Q_D(const LoopPool);
+    return d->policy;
+}
+
+
+int LoopPool::spawn(const std::function<void()> &func)
+{
+    Q_D(LoopPool);
+    if(d->stopped.load()) {
+        return -1;
+    }
+    int index = d->choose();
+    if(!d->spawnOn(index, func)) {
+        return -1;
+    }
+    return index;
+}
+
+
+bool LoopPool::spawnOn(int index, const std::function<void()> &func)
+{
+    Q_D(LoopPool);
+    return d->spawnOn(index, func);
+}
+
+
+bool LoopPool::spawnOn(EventLoopCoroutine *loop, const std::function<void()> &func)
+{
+    Q_D(LoopPool);
+    return d->spawnOn(indexOf(loop), func);
+}
+
+
+void LoopPool::stop()
+{
+    Q_D(LoopPool);
+    d->stop();
+}
+
+// 开始实现 ReusePortServer
+
+struct ReusePortServerState
+{
+    std::function<void(QSharedPointer<Socket>)> handler;
+    ThreadEvent stopEvent;
+    ThreadEvent finished;
+    QAtomicInt running;
+};
+
+
+// owned by the spawned function, so the shard is finished even if LoopPool::stop() kills it before it runs.
+struct ShardGuard
+{
+    ShardGuard(QSharedPointer<ReusePortServerState> state, QSharedPointer<Socket> socket)
+        :state(state), socket(socket), done(0) {}
+    ~ShardGuard() { finish(); }
+    void finish()
+    {
+        if(!done.testAndSetOrdered(0, 1)) {
+            return;
+        }
+        socket->close();
+        if(!state->running.deref()) {
+            state->finished.set();
+        }
+    }
+    QSharedPointer<ReusePortServerState> state;
+    QSharedPointer<Socket> socket;
+    QAtomicInt done;
+};
+
+
+// close the listening socket in its own thread, even if the shard is killed by LoopPool::stop().
+static void serveShard(QSharedPointer<ShardGuard> guard)
+{
+    QSharedPointer<ReusePortServerState> state = guard->state;
+    QSharedPointer<Socket> socket = guard->socket;
+    try {
+        CoroutineGroup operations;
+        CoroutineGroup *handlers = &operations;
+        operations.spawn([state, socket, handlers] {
+            acceptLoop(socket.data(), handlers, state->handler);
+        });
+        state->stopEvent.wait();
+    } catch(...) {
+        guard->finish();
+        throw;
+    }
+    guard->finish();
+}
+
+
+class ReusePortServerPrivate
+{
+public:
+    ReusePortServerPrivate(LoopPool *pool, const QHostAddress &address, quint16 port);
+public:
+    QSharedPointer<Socket> makeSocket(bool *reusePort);
+    void setError(QSharedPointer<Socket> socket);
+public:
+    LoopPool *pool;
+    QHostAddress address;
+    quint16 port;
+    int shards;
+    std::function<void(QSharedPointer<Socket>)> handler;
+    QSharedPointer<ReusePortServerState> state;
+    Socket::SocketError error;
+    QString errorString;
+};
+
+
+ReusePortServerPrivate::ReusePortServerPrivate(LoopPool *pool, const QHostAddress &address, quint16 port)
+    :pool(pool), address(address), port(port), shards(0), error(Socket::NoError)
+{
+}
+
+
+QSharedPointer<Socket> ReusePortServerPrivate::makeSocket(bool *reusePort)
+{
+    Socket::NetworkLayerProtocol protocol;
+    switch(address.protocol()) {
+    case QAbstractSocket::IPv4Protocol:
+        protocol = Socket::IPv4Protocol;
+        break;
+    case QAbstractSocket::IPv6Protocol:
+        protocol = Socket::IPv6Protocol;
+        break;
+    default:
+        protocol = Socket::AnyIPProtocol;
+        break;
+    }
+    QSharedPointer<Socket> socket(new Socket(protocol, Socket::TcpSocket));
+    socket->setOption(Socket::AddressReusable, true);
+    *reusePort = socket->setOption(Socket::ReusePortOption, true);
+    return socket;
+}
+
+
+void ReusePortServerPrivate::setError(QSharedPointer<Socket> socket)
+{
+    error = socket->error();
+    errorString = socket->errorString();
+}
+
+
+ReusePortServer::ReusePortServer(LoopPool *pool, const QHostAddress &address, quint16 port)
+    :d_ptr(new ReusePortServerPrivate(pool, address, port))
+{
+}
+
+
+ReusePortServer::~ReusePortServer()
+{
+    stop();
+    delete d_ptr;
+}
+
+
+void ReusePortServer::setHandler(const std::function<void(QSharedPointer<Socket>)> &handler)
+{
+    Q_D(ReusePortServer);
+    d->handler = handler;
+}
+
+
+bool ReusePortServer::start(int backlog)
+{
+    Q_D(ReusePortServer);
+    if(!d->state.isNull()) {
+        return true;
+    }
+    if(!d->handler) {
+        d->error = Socket::OperationError;
+        d->errorString = QStringLiteral("The handler of connections is not set.");
+        return false;
+    }
+
+    // every socket is bound to the port chosen by the first one. without SO_REUSEPORT only the first loop accepts.
+    QList<QSharedPointer<Socket>> sockets;
+    for(int i = 0; i < d->pool->size(); ++i) {
+        bool reusePort;
+        QSharedPointer<Socket> socket = d->makeSocket(&reusePort);
+        if(!socket->isValid() || !socket->bind(d->address, d->port) || !socket->listen(backlog)) {
+            d->setError(socket);
+            socket->close();
+            for(QSharedPointer<Socket> s: sockets) {
+                s->close();
+            }
+            return false;
+        }
+        if(d->port == 0) {
+            d->port = socket->localPort();
+        }
+        sockets.append(socket);
+        if(!reusePort) {
+            break;
+        }
+    }
+
+    QSharedPointer<ReusePortServerState> state(new ReusePortServerState());
+    state->handler = d->handler;
+    state->running.store(sockets.size());
+    int shards = 0;
+    for(int i = 0; i < sockets.size(); ++i) {
+        QSharedPointer<ShardGuard> guard(new ShardGuard(state, sockets.at(i)));
+        if(d->pool->spawnOn(i, [guard] { serveShard(guard); })) {
+            ++shards;
+        }
+    }
+    if(shards == 0) {
+        d->error = Socket::OperationError;
+        d->errorString = QStringLiteral("The loop pool is stopped.");
+        return false;
+    }
+    d->shards = shards;
+    d->state = state;
+    d->error = Socket::NoError;
+    d->errorString.clear();
+    return true;
+}
+
+
+void ReusePortServer::stop()
+{
+    Q_D(ReusePortServer);
+    if(d->state.isNull()) {
+        return;
+    }
+    d->state->stopEvent.set();
+    d->state->finished.wait();
+    d->state.clear();
+    d->shards = 0;
+}
+
+
+bool ReusePortServer::isRunning() const
+{
+    Q_D(const ReusePortServer);
+    return !d->state.isNull();
+}
+
+
+int ReusePortServer::shards() const
+{
+    Q_D(const ReusePortServer);
+    return d->shards;
+}
+
+
+quint16 ReusePortServer::serverPort() const
+{
+    Q_D(const ReusePortServer);
+    return d->port;
+}
+
+
+Socket::SocketError ReusePortServer::error() const
+{
+    Q_D(const ReusePortServer);
+    return d->error;
+}
+
+
+QString ReusePortServer::errorString() const
+{
+    Q_D(const ReusePortServer);
+    return d->errorString;
+}
+
+// 开始实现 ThreadEvent
+
+struct ThreadEventWaiter
+{
+    ThreadEventWaiter()
+        :thread(QThread::currentThread()), loop(EventLoopCoroutine::get()), flag(false) {}
+    QThread *thread;
+    QPointer<EventLoopCoroutine> loop;
+    Event event;
+    bool flag;
+};
+
+
+class ThreadEventPrivate
+{
+public:
+    ThreadEventPrivate();
+    ~ThreadEventPrivate();
+public:
+    void wakeAll(bool flag);
+public:
+    mutable QMutex mutex;
+    QList<QSharedPointer<ThreadEventWaiter>> waiters;
+    bool flag;
+};
+
+
+ThreadEventPrivate::ThreadEventPrivate()
+    :flag(false)
+{
+}
+
+
+ThreadEventPrivate::~ThreadEventPrivate()
+{
+    wakeAll(false);
+}
+
+
+// the waiters are waked by their own event loops, because Event is not thread-safe.
+void ThreadEventPrivate::wakeAll(bool flag)
+{
+    QList<QSharedPointer<ThreadEventWaiter>> waiters;
+    {
+        QMutexLocker locker(&mutex);
+        waiters.swap(this->waiters);
+    }
+    for(QSharedPointer<ThreadEventWaiter> waiter: waiters) {
+        if(waiter->thread == QThread::currentThread()) {
+            waiter->flag = flag;
+            waiter->event.set();
+        } else if(!waiter->loop.isNull()) {
+            waiter->loop->callLaterThreadSafe(0, new LambdaFunctor([waiter, flag] {
+                waiter->flag = flag;
+                waiter->event.set();
+            }));
+        }
+    }
+}
+
+
+ThreadEvent::ThreadEvent()
+    :d_ptr(new ThreadEventPrivate())
+{
+}
+
+
+ThreadEvent::~ThreadEvent()
+{
+    delete d_ptr;
+}
+
+
+bool ThreadEvent::wait(bool blocking)
+{
+    Q_D(ThreadEvent);
+    QSharedPointer<ThreadEventWaiter> waiter;
+    {
+        QMutexLocker locker(&d->mutex);
+        if(d->flag || !blocking) {
+            return d->flag;
+        }
+        waiter.reset(new ThreadEventWaiter());
+        d->waiters.append(waiter);
+    }
+    try {
+        waiter->event.wait();
+    } catch(...) {
+        QMutexLocker locker(&d->mutex);
+        d->waiters.removeOne(waiter);
+        throw;
+    }
+    // do not touch `d` here, the ThreadEvent may be deleted already.
+    return waiter->flag;
+}
+
+
+void ThreadEvent::set()
+{
+    Q_D(ThreadEvent);
+    {
+        QMutexLocker locker(&d->mutex);
+        if(d->flag) {
+            return;
+        }
+        d->flag = true;
+    }
+    d->wakeAll(true);
+}
+
+
+void ThreadEvent::clear()
+{
+    Q_D(ThreadEvent);
+    QMutexLocker locker(&d->mutex);
+    d->flag = false;
+}
+
+
+bool ThreadEvent::isSet() const
+{
+    Q_D(const ThreadEvent);
+    QMutexLocker locker(&d->mutex);
+    return d->flag;
+}
+
+
+int ThreadEvent::getting() const
+{
+    Q_D(const ThreadEvent);
+    QMutexLocker locker(&d->mutex);
+    return d->waiters.size();
+}
+
+QTNETWORKNG_NAMESPACE_END
@@ -427,6 +427,21 @@ DEFINEFUNC(BIO_METHOD *, BIO_s_mem, void, DUMMYARG, return 0, return)
 DEFINEFUNC3(int, BIO_read, BIO *a, a, void *b, b, int c, c, return -1, return)
 DEFINEFUNC3(int, BIO_write, BIO *a, a, const void *b, b, int c, c, return -1, return)
 DEFINEFUNC(int, BIO_up_ref, BIO *a, a, return -1, return)
+DEFINEFUNC(int, BIO_get_new_index, void, DUMMYARG, return -1, return)
+bool has_BIO_get_new_index()
+{
+    return _q_BIO_get_new_index != 0;
+}
+DEFINEFUNC2(BIO_METHOD *, BIO_meth_new, int a, a, const char *b, b, return 0, return)
+DEFINEFUNC2(int, BIO_meth_set_write, BIO_METHOD *a, a, q_bio_write_t b, b, return 0, return)
+DEFINEFUNC2(int, BIO_meth_set_read, BIO_METHOD *a, a, q_bio_read_t b, b, return 0, return)
+DEFINEFUNC2(int, BIO_meth_set_ctrl, BIO_METHOD *a, a, q_bio_ctrl_t b, b, return 0, return)
+DEFINEFUNC2(void, BIO_set_data, BIO *a, a, void *b, b, return, DUMMYARG)
+DEFINEFUNC(void *, BIO_get_data, BIO *a, a, return 0, return)
+DEFINEFUNC2(void, BIO_set_init, BIO *a, a, int b, b, return, DUMMYARG)
+DEFINEFUNC2(void, BIO_set_flags, BIO *a, a, int b, b, return, DUMMYARG)
+DEFINEFUNC2(void, BIO_clear_flags, BIO *a, a, int b, b, return, DUMMYARG)
+DEFINEFUNC2(BIO *, BIO_new_socket, int a, a, int b, b, return 0, return)
 DEFINEFUNC(int, BN_num_bits, const BIGNUM *a, a, return 0, return)
 DEFINEFUNC2(int, BN_is_word, BIGNUM *a, a, BN_ULONG w, w, return 0, return)
 DEFINEFUNC2(BN_ULONG, BN_mod_word, const BIGNUM *a, a, BN_ULONG w, w, return static_cast<BN_ULONG>(-1), return)
@@ -473,6 +488,7 @@ DEFINEFUNC2(int, SSL_CTX_set_cipher_list, SSL_CTX *a, a, const char *b, b, retur
 DEFINEFUNC(int, SSL_CTX_set_default_verify_paths, SSL_CTX *a, a, return -1, return)
 DEFINEFUNC3(void, SSL_CTX_set_verify, SSL_CTX *a, a, int b, b, int (*c)(int, X509_STORE_CTX *), c, return, DUMMYARG)
 DEFINEFUNC2(void, SSL_CTX_set_verify_depth, SSL_CTX *a, a, int b, b, return, DUMMYARG)
+DEFINEFUNC3(int, SSL_CTX_set_session_id_context, SSL_CTX *a, a, const unsigned char *b, b, unsigned int c, c, return 0, return)
 DEFINEFUNC2(int, SSL_CTX_use_certificate, SSL_CTX *a, a, X509 *b, b, return -1, return)
 DEFINEFUNC3(int, SSL_CTX_use_certificate_file, SSL_CTX *a, a, const char *b, b, int c, c, return -1, return)
 DEFINEFUNC2(int, SSL_CTX_use_PrivateKey, SSL_CTX *a, a, EVP_PKEY *b, b, return -1, return)
@@ -496,6 +512,7 @@ DEFINEFUNC(void, SSL_load_error_strings, void, DUMMYARG, return, DUMMYARG)
 DEFINEFUNC(SSL *, SSL_new, SSL_CTX *a, a, return 0, return)
 DEFINEFUNC4(long, SSL_ctrl, SSL *a, a, int cmd, cmd, long larg, larg, void *parg, parg, return -1, return)
 DEFINEFUNC3(int, SSL_read, SSL *a, a, void *b, b, int c, c, return -1, return)
+DEFINEFUNC(int, SSL_pending, const SSL *a, a, return 0, return)
 DEFINEFUNC3(void, SSL_set_bio, SSL *a, a, BIO *b, b, BIO *c, c, return, DUMMYARG)
 DEFINEFUNC2(void, SSL_set0_rbio, SSL *a, a, BIO *b, b, return, DUMMYARG)
 DEFINEFUNC(BIO *, SSL_get_rbio, SSL *a, a, return NULL, return)
@@ -504,6 +521,8 @@ DEFINEFUNC(BIO *, SSL_get_wbio, SSL *a, a, return NULL;, return)
 DEFINEFUNC(void, SSL_set_accept_state, SSL *a, a, return, DUMMYARG)
 DEFINEFUNC(void, SSL_set_connect_state, SSL *a, a, return, DUMMYARG)
 DEFINEFUNC(int, SSL_shutdown, SSL *a, a, return -1, return)
+DEFINEFUNC2(quint64, SSL_set_options, SSL *a, a, quint64 b, b, return 0, return)
+
 DEFINEFUNC2(int, SSL_set_session, SSL* to, to, SSL_SESSION *session, session, return -1, return)
 DEFINEFUNC(void, SSL_SESSION_free, SSL_SESSION *ses, ses, return, DUMMYARG)
 DEFINEFUNC(SSL_SESSION*, SSL_get1_session, SSL *ssl, ssl, return 0, return)
@@ -550,6 +569,7 @@ DEFINEFUNC(void, OPENSSL_add_all_algorithms_conf, void, DUMMYARG, return, DUMMYA
 DEFINEFUNC3(int, SSL_CTX_load_verify_locations, SSL_CTX *ctx, ctx, const char *CAfile, CAfile, const char *CApath, CApath, return 0, return)
 DEFINEFUNC(long, SSLeay, void, DUMMYARG, return 0, return)
 DEFINEFUNC(const char *, SSLeay_version, int a, a, return 0, return)
+DEFINEFUNC(unsigned long, OpenSSL_version_num, void, DUMMYARG, return 0, return)
 DEFINEFUNC2(int, i2d_SSL_SESSION, SSL_SESSION *in, in, unsigned char **pp, pp, return 0, return)
 DEFINEFUNC3(SSL_SESSION *, d2i_SSL_SESSION, SSL_SESSION **a, a, const unsigned char **pp, pp, long length, length, return 0, return)
 #if OPENSSL_VERSION_NUMBER >= 0x1000100fL && !defined(OPENSSL_NO_NEXTPROTONEG)
@@ -1117,6 +1137,17 @@ bool q_resolveOpenSslSymbols(bool force)
     RESOLVEFUNC(BIO_read)
     RESOLVEFUNC(BIO_write)
     RESOLVEFUNC(BIO_up_ref)
+    RESOLVEFUNC(BIO_get_new_index)
+    RESOLVEFUNC(BIO_meth_new)
+    RESOLVEFUNC(BIO_meth_set_write)
+    RESOLVEFUNC(BIO_meth_set_read)
+    RESOLVEFUNC(BIO_meth_set_ctrl)
+    RESOLVEFUNC(BIO_set_data)
+    RESOLVEFUNC(BIO_get_data)
+    RESOLVEFUNC(BIO_set_init)
+    RESOLVEFUNC(BIO_set_flags)
+    RESOLVEFUNC(BIO_clear_flags)
+    RESOLVEFUNC(BIO_new_socket)
     RESOLVEFUNC(EC_KEY_get0_group)
     RESOLVEFUNC(EC_GROUP_get_degree)
     RESOLVEFUNC(BN_num_bits)
@@ -1176,6 +1207,7 @@ bool q_resolveOpenSslSymbols(bool force)
     RESOLVEFUNC(SSL_CTX_set_default_verify_paths)
     RESOLVEFUNC(SSL_CTX_set_verify)
     RESOLVEFUNC(SSL_CTX_set_verify_depth)
+    RESOLVEFUNC(SSL_CTX_set_session_id_context)
     RESOLVEFUNC(SSL_CTX_use_certificate)
     RESOLVEFUNC(SSL_CTX_use_certificate_file)
     RESOLVEFUNC(SSL_CTX_use_PrivateKey)
@@ -1200,6 +1232,7 @@ bool q_resolveOpenSslSymbols(bool force)
     RESOLVEFUNC(SSL_new)
     RESOLVEFUNC(SSL_ctrl)
     RESOLVEFUNC(SSL_read)
+    RESOLVEFUNC(SSL_pending)
     RESOLVEFUNC(SSL_set_accept_state)
     RESOLVEFUNC(SSL_set_bio)
     RESOLVEFUNC(SSL_set0_rbio)
@@ -1208,6 +1241,7 @@ bool q_resolveOpenSslSymbols(bool force)
     RESOLVEFUNC(SSL_get_wbio)
     RESOLVEFUNC(SSL_set_connect_state)
     RESOLVEFUNC(SSL_shutdown)
+    RESOLVEFUNC(SSL_set_options)
     RESOLVEFUNC(SSL_set_session)
     RESOLVEFUNC(SSL_SESSION_free)
     RESOLVEFUNC(SSL_get1_session)
@@ -1296,6 +1330,7 @@ bool q_resolveOpenSslSymbols(bool force)
     RESOLVEFUNC(SSL_CTX_load_verify_locations)
     RESOLVEFUNC(SSLeay)
     RESOLVEFUNC(SSLeay_version)
+    RESOLVEFUNC(OpenSSL_version_num)
     RESOLVEFUNC(i2d_SSL_SESSION)
     RESOLVEFUNC(d2i_SSL_SESSION)
 #if OPENSSL_VERSION_NUMBER >= 0x1000100fL && !defined(OPENSSL_NO_NEXTPROTONEG)
@@ -2,7 +2,13 @@
 #include <QtCore/qcoreapplication.h>
 #include <QtCore/qmap.h>
 #include <QtCore/qcache.h>
+#include <QtCore/qdatetime.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qthreadpool.h>
+#include <QtCore/qrunnable.h>
+#include <QtCore/qpointer.h>
 #include "../include/socket_p.h"
+#include "../include/dns.h"
 #include "../include/coroutine_utils.h"
 
 QTNETWORKNG_NAMESPACE_BEGIN
@@ -10,7 +16,8 @@ QTNETWORKNG_NAMESPACE_BEGIN
 SocketPrivate::SocketPrivate(Socket::NetworkLayerProtocol protocol,
         Socket::SocketType type, Socket *parent)
     :q_ptr(parent), protocol(protocol), type(type), error(Socket::NoError),
-      state(Socket::UnconnectedState)
+      state(Socket::UnconnectedState), connectAttemptDelay(250), connectTimeout(0),
+      readWatcher(EventLoopCoroutine::Read), writeWatcher(EventLoopCoroutine::Write), udpGso(false), udpGro(false)
 {
 #ifdef Q_OS_WIN
     initWinSock();
@@ -31,7 +38,8 @@ SocketPrivate::SocketPrivate(Socket::NetworkLayerProtocol protocol,
 }
 
 SocketPrivate::SocketPrivate(qintptr socketDescriptor, Socket *parent)
-    :q_ptr(parent), error(Socket::NoError)
+    :q_ptr(parent), error(Socket::NoError), connectAttemptDelay(250), connectTimeout(0),
+      readWatcher(EventLoopCoroutine::Read), writeWatcher(EventLoopCoroutine::Write), udpGso(false), udpGro(false)
 {
 #ifdef Q_OS_WIN
     initWinSock();
@@ -47,6 +55,18 @@ SocketPrivate::SocketPrivate(qintptr socketDescriptor, Socket *parent)
     fetchConnectionParameters();
 }
 
+// the connection accepted by `listener`. the caller fills the addresses without asking the kernel again.
+SocketPrivate::SocketPrivate(qintptr socketDescriptor, const SocketPrivate *listener)
+    :q_ptr(0), protocol(listener->protocol), type(Socket::TcpSocket), error(Socket::NoError),
+      state(Socket::ConnectedState), localAddress(listener->localAddress), localPort(listener->localPort),
+      peerPort(0), fd(socketDescriptor), connectAttemptDelay(250), connectTimeout(0),
+      readWatcher(EventLoopCoroutine::Read), writeWatcher(EventLoopCoroutine::Write), udpGso(false), udpGro(false)
+{
+#ifdef Q_OS_WIN
+    initWinSock();
+#endif
+}
+
 SocketPrivate::~SocketPrivate()
 {
     close();
@@ -60,7 +80,31 @@ bool SocketPrivate::bind(quint16 port, Socket::BindMode mode)
     return bind(QHostAddress(QHostAddress::Any), port, mode);
 }
 
-bool SocketPrivate::connect(const QString &hostName, quint16 port, Socket::NetworkLayerProtocol protocol)
+// RFC 8305 section 4: alternate between IPv6 and IPv4, starting with the family of the first address.
+static QList<QHostAddress> interleaveAddressFamilies(const QList<QHostAddress> &addresses)
+{
+    QList<QHostAddress> preferred, others;
+    QAbstractSocket::NetworkLayerProtocol family = addresses.first().protocol();
+    for(const QHostAddress &addr: addresses) {
+        if(addr.protocol() == family) {
+            preferred.append(addr);
+        } else {
+            others.append(addr);
+        }
+    }
+    QList<QHostAddress> result;
+    for(int i = 0; i < preferred.size() || i < others.size(); ++i) {
+        if(i < preferred.size()) {
+            result.append(preferred.at(i));
+        }
+        if(i < others.size()) {
+            result.append(others.at(i));
+        }
+    }
+    return result;
+}
+
+bool SocketPrivate::lookup(const QString &hostName, Socket::NetworkLayerProtocol protocol, QList<QHostAddress> *candidates)
 {
     state = Socket::HostLookupState;
     QList<QHostAddress> addresses;
@@ -75,24 +119,44 @@ bool SocketPrivate::connect(const QString &hostName, quint16 port, Socket::Netwo
         }
     }
 
-    if(addresses.isEmpty()) {
-        state = Socket::UnconnectedState;
-        setError(Socket::HostNotFoundError, QStringLiteral("Host not found."));
-        return false;
-    }
-    bool done = true;
-    state = Socket::UnconnectedState;
-    for(int i = 0; i < addresses.size(); ++i) {
-        QHostAddress addr = addresses.at(i);
-        if(protocol == Socket::IPv4Protocol && addr.protocol() != QAbstractSocket::IPv4Protocol) {
+    for(const QHostAddress &addr: addresses) {
+        if((protocol == Socket::IPv4Protocol || this->protocol == Socket::IPv4Protocol)
+                && addr.protocol() != QAbstractSocket::IPv4Protocol) {
             continue;
         }
         if(protocol == Socket::IPv6Protocol && addr.protocol() != QAbstractSocket::IPv6Protocol) {
             continue;
         }
-        done = connect(addr, port);
-        if(done)
+        candidates->append(addr);
+    }
+    state = Socket::UnconnectedState;
+    if(candidates->isEmpty()) {
+        setError(Socket::HostNotFoundError, QStringLiteral("Host not found."));
+        return false;
+    }
+    return true;
+}
+
+bool SocketPrivate::connect(const QString &hostName, quint16 port, Socket::NetworkLayerProtocol protocol)
+{
+    const bool fresh = state == Socket::UnconnectedState;
+    QList<QHostAddress> candidates;
+    if(!lookup(hostName, protocol, &candidates)) {
+        return false;
+    }
+    return connectToAny(candidates, port, fresh);
+}
+
+bool SocketPrivate::connectToAny(const QList<QHostAddress> &candidates, quint16 port, bool fresh)
+{
+    // a bound socket can not be replaced by new sockets, so it tries the addresses one by one.
+    if(candidates.size() > 1 && fresh && type == Socket::TcpSocket) {
+        return connectInParallel(interleaveAddressFamilies(candidates), port);
+    }
+    for(const QHostAddress &addr: candidates) {
+        if(connectWithTimeout(addr, port)) {
             return true;
+        }
     }
     if(error == Socket::NoError) {
         setError(Socket::HostNotFoundError, QStringLiteral("Host not found."));
@@ -100,6 +164,144 @@ bool SocketPrivate::connect(const QString &hostName, quint16 port, Socket::Netwo
     return false;
 }
 
+// only one of the sockets racing for many addresses could carry the data in SYN, so fast open is used for a single address.
+qint64 SocketPrivate::connectAndSend(const QString &hostName, quint16 port, const char *data, qint64 size,
+                                     Socket::NetworkLayerProtocol protocol)
+{
+    const bool fresh = state == Socket::UnconnectedState;
+    QList<QHostAddress> candidates;
+    if(!lookup(hostName, protocol, &candidates)) {
+        return -1;
+    }
+    if(candidates.size() == 1) {
+        return connectAndSend(candidates.first(), port, data, size);
+    }
+    if(!connectToAny(candidates, port, fresh)) {
+        return -1;
+    }
+    return send(data, size, true);
+}
+
+bool SocketPrivate::connectWithTimeout(const QHostAddress &host, quint16 port)
+{
+    if(connectTimeout <= 0) {
+        return connect(host, port);
+    }
+    // not a Timeout, whose exception can not be told from the one of caller's Timeout.
+    bool expired = false;
+    QPointer<BaseCoroutine> current = BaseCoroutine::current();
+    int callbackId = EventLoopCoroutine::get()->callLater(connectTimeout, new LambdaFunctor([&expired, current] {
+        if(!current.isNull()) {
+            expired = true;
+            current->raise(new TimeoutException());
+        }
+    }));
+    try {
+        bool ok = connect(host, port);
+        EventLoopCoroutine::get()->cancelCall(callbackId);
+        return ok;
+    } catch(TimeoutException &) {
+        EventLoopCoroutine::get()->cancelCall(callbackId);
+        if(!expired) {
+            throw;
+        }
+        setError(Socket::SocketTimeoutError, ConnectionTimeOutErrorString);
+        state = Socket::UnconnectedState;
+        return false;
+    } catch(...) {
+        EventLoopCoroutine::get()->cancelCall(callbackId);
+        throw;
+    }
+}
+
+// Happy Eyeballs: every attempt connects a new socket. the next attempt starts after `connectAttemptDelay`
+// milliseconds, or as soon as all started attempts failed. the first connected socket wins, and the others are killed.
+bool SocketPrivate::connectInParallel(const QList<QHostAddress> &addresses, quint16 port)
+{
+    QSharedPointer<Socket> winner;
+    Socket::SocketError lastError = Socket::NoError;
+    QString lastErrorString;
+    int started = 0;
+    int failed = 0;
+    bool due = true;
+    Event changed;
+    CoroutineGroup attempts;
+
+    state = Socket::ConnectingState;
+    while(winner.isNull() && failed < addresses.size()) {
+        if(started < addresses.size() && (due || failed == started)) {
+            due = connectAttemptDelay <= 0;
+            const QHostAddress addr = addresses.at(started++);
+            attempts.spawn([this, addr, port, &winner, &lastError, &lastErrorString, &failed, &changed] {
+                QSharedPointer<Socket> s(new Socket(protocol, Socket::TcpSocket));
+                SocketPrivate *d = s->d_ptr;
+                d->connectTimeout = connectTimeout;
+                for(QMap<Socket::SocketOption, QVariant>::const_iterator itor = presetOptions.constBegin(); itor != presetOptions.constEnd(); ++itor) {
+                    d->setOption(itor.key(), itor.value());
+                }
+                if(d->connectWithTimeout(addr, port)) {
+                    if(winner.isNull()) {
+                        winner = s;
+                    }
+                } else {
+                    lastError = d->error;
+                    lastErrorString = d->errorString;
+                    ++failed;
+                }
+                changed.set();
+            });
+            continue;
+        }
+        changed.clear();
+        int callbackId = 0;
+        if(started < addresses.size()) {
+            // the exception of caller's Timeout must pass through, so the delay is not a Timeout.
+            callbackId = EventLoopCoroutine::get()->callLater(connectAttemptDelay, new LambdaFunctor([&due, &changed] {
+                due = true;
+                changed.set();
+            }));
+        }
+        try {
+            changed.wait();
+        } catch(...) {
+            if(callbackId) {
+                EventLoopCoroutine::get()->cancelCall(callbackId);
+            }
+            state = Socket::UnconnectedState;
+            throw;
+        }
+        if(callbackId) {
+            EventLoopCoroutine::get()->cancelCall(callbackId);
+        }
+    }
+    attempts.killall();
+
+    if(winner.isNull()) {
+        state = Socket::UnconnectedState;
+        setError(lastError, lastErrorString);
+        return false;
+    }
+    takeConnection(winner->d_ptr);
+    return true;
+}
+
+void SocketPrivate::takeConnection(SocketPrivate *other)
+{
+    close();
+    other->readWatcher.reset();
+    other->writeWatcher.reset();
+    fd = other->fd;
+    other->fd = -1;
+    other->state = Socket::UnconnectedState;
+    state = Socket::ConnectedState;
+    error = Socket::NoError;
+    errorString.clear();
+    localAddress = other->localAddress;
+    localPort = other->localPort;
+    peerAddress = other->peerAddress;
+    peerPort = other->peerPort;
+}
+
 void SocketPrivate::setError(Socket::SocketError error, const QString &errorString)
 {
     this->error = error;
@@ -222,6 +424,12 @@ Socket::Socket(qintptr socketDescriptor)
 {
 }
 
+Socket::Socket(SocketPrivate *d)
+    :d_ptr(d)
+{
+    d->q_ptr = this;
+}
+
 Socket::~Socket()
 {
     delete d_ptr;
@@ -305,6 +513,12 @@ Socket *Socket::accept()
     return d->accept();
 }
 
+QList<Socket*> Socket::acceptMany(int maxCount)
+{
+    Q_D(Socket);
+    return d->acceptMany(maxCount);
+}
+
 bool Socket::bind(QHostAddress &address, quint16 port, Socket::BindMode mode)
 {
     Q_D(Socket);
@@ -329,6 +543,18 @@ bool Socket::connect(const QString &hostName, quint16 port, Socket::NetworkLayer
     return d->connect(hostName, port, protocol);
 }
 
+qint64 Socket::connectAndSend(const QHostAddress &host, quint16 port, const QByteArray &data)
+{
+    Q_D(Socket);
+    return d->connectAndSend(host, port, data.constData(), data.size());
+}
+
+qint64 Socket::connectAndSend(const QString &hostName, quint16 port, const QByteArray &data, Socket::NetworkLayerProtocol protocol)
+{
+    Q_D(Socket);
+    return d->connectAndSend(hostName, port, data.constData(), data.size(), protocol);
+}
+
 bool Socket::close()
 {
     Q_D(Socket);
@@ -344,7 +570,12 @@ bool Socket::listen(int backlog)
 bool Socket::setOption(Socket::SocketOption option, const QVariant &value)
 {
     Q_D(Socket);
-    return d->setOption(option, value);
+    bool done = d->setOption(option, value);
+    // connect(hostName) may connect a new socket, which takes the options set before.
+    if(done && d->state == Socket::UnconnectedState) {
+        d->presetOptions.insert(option, value);
+    }
+    return done;
 }
 
 QVariant Socket::option(Socket::SocketOption option) const
@@ -394,6 +625,56 @@ qint64 Socket::sendto(const char *data, qint64 size, const QHostAddress &addr, q
     return d->sendto(data, size, addr, port);
 }
 
+qint64 Socket::sendv(const QList<QByteArray> &data)
+{
+    Q_D(Socket);
+    return d->sendv(data);
+}
+
+qint64 Socket::recvv(QList<QByteArray> &buffers)
+{
+    Q_D(Socket);
+    return d->recvv(buffers);
+}
+
+qint64 Socket::sendfile(QFile &file, qint64 offset, qint64 length)
+{
+    Q_D(Socket);
+    if(!file.isOpen()) {
+        return -1;
+    }
+    // the data buffered by QFile is not written yet.
+    file.flush();
+    if(length < 0) {
+        length = qMax<qint64>(file.size() - offset, 0);
+    }
+    return d->sendfile(file.handle(), offset, length);
+}
+
+qint64 Socket::sendfile(int fileDescriptor, qint64 offset, qint64 length)
+{
+    Q_D(Socket);
+    return d->sendfile(fileDescriptor, offset, length);
+}
+
+qint64 Socket::splice(Socket &source, qint64 length)
+{
+    Q_D(Socket);
+    return d->splice(source.d_func(), length);
+}
+
+int Socket::recvmany(DatagramBatch &batch)
+{
+    Q_D(Socket);
+    return d->recvmany(&batch);
+}
+
+int Socket::sendmany(const DatagramBatch &batch)
+{
+    Q_D(Socket);
+    return d->sendmany(&batch);
+}
+
 QByteArray Socket::recv(qint64 size)
 {
     Q_D(Socket);
@@ -460,6 +741,212 @@ qint64 Socket::sendto(const QByteArray &data, const QHostAddress &addr, quint16
     return d->sendto(data.data(), data.size(), addr, port);
 }
 
+// 开始实现 DatagramBatch
+
+DatagramBatchPrivate::DatagramBatchPrivate(int capacity, int datagramSize)
+    :arena(capacity * datagramSize, Qt::Uninitialized), capacity(capacity), datagramSize(datagramSize), used(0)
+{
+    entries.reserve(capacity);
+}
+
+DatagramBatch::DatagramBatch(int capacity, int datagramSize)
+    :d_ptr(new DatagramBatchPrivate(qMax(capacity, 1), qBound(1, datagramSize, 0xffff)))
+{
+}
+
+DatagramBatch::~DatagramBatch()
+{
+    delete d_ptr;
+}
+
+int DatagramBatch::capacity() const
+{
+    Q_D(const DatagramBatch);
+    return d->capacity;
+}
+
+int DatagramBatch::datagramSize() const
+{
+    Q_D(const DatagramBatch);
+    return d->datagramSize;
+}
+
+int DatagramBatch::size() const
+{
+    Q_D(const DatagramBatch);
+    return d->entries.size();
+}
+
+bool DatagramBatch::isEmpty() const
+{
+    Q_D(const DatagramBatch);
+    return d->entries.isEmpty();
+}
+
+void DatagramBatch::clear()
+{
+    Q_D(DatagramBatch);
+    d->entries.clear();
+    d->used = 0;
+}
+
+// the payloads are packed one after another, so sendmany() can pass a run of them to GSO as one buffer.
+bool DatagramBatch::append(const char *data, int size, const QHostAddress &addr, quint16 port)
+{
+    Q_D(DatagramBatch);
+    if(size < 0 || size > d->datagramSize || d->entries.size() >= d->capacity || d->used + size > d->arena.size()) {
+        return false;
+    }
+    DatagramBatchPrivate::Entry entry;
+    entry.offset = d->used;
+    entry.length = size;
+    entry.addr = addr;
+    entry.port = port;
+    entry.truncated = false;
+    memcpy(d->arena.data() + d->used, data, static_cast<size_t>(size));
+    d->used += size;
+    d->entries.append(entry);
+    return true;
+}
+
+bool DatagramBatch::append(const QByteArray &data, const QHostAddress &addr, quint16 port)
+{
+    return append(data.constData(), data.size(), addr, port);
+}
+
+const char *DatagramBatch::data(int i) const
+{
+    Q_D(const DatagramBatch);
+    return d->arena.constData() + d->entries.at(i).offset;
+}
+
+int DatagramBatch::length(int i) const
+{
+    Q_D(const DatagramBatch);
+    return d->entries.at(i).length;
+}
+
+// the datagram received was larger than `datagramSize`, and the rest of it is discarded.
+bool DatagramBatch::isTruncated(int i) const
+{
+    Q_D(const DatagramBatch);
+    return d->entries.at(i).truncated;
+}
+
+QByteArray DatagramBatch::datagram(int i) const
+{
+    Q_D(const DatagramBatch);
+    const DatagramBatchPrivate::Entry &entry = d->entries.at(i);
+    return QByteArray(d->arena.constData() + entry.offset, entry.length);
+}
+
+QHostAddress DatagramBatch::address(int i) const
+{
+    Q_D(const DatagramBatch);
+    return d->entries.at(i).addr;
+}
+
+quint16 DatagramBatch::port(int i) const
+{
+    Q_D(const DatagramBatch);
+    return d->entries.at(i).port;
+}
+
+// 开始写 HostResolver 的实现
+// the blocking QHostInfo::fromName() is run in a bounded thread pool shared by the whole process,
+// and coroutines resolving the same host name at the same time wait for one lookup.
+namespace {
+
+struct PendingLookup
+{
+    QList<QHostAddress> addresses;
+    QList<QPair<QPointer<EventLoopCoroutine>, QSharedPointer<Event>>> waiters;
+};
+
+
+class HostResolver
+{
+public:
+    HostResolver();
+    QList<QHostAddress> resolve(const QString &hostName);
+    void finish(const QString &hostName, const QList<QHostAddress> &addresses);
+private:
+    QThreadPool pool;
+    QMutex mutex;
+    QMap<QString, QSharedPointer<PendingLookup>> pending;
+};
+
+
+class HostResolverTask: public QRunnable
+{
+public:
+    HostResolverTask(HostResolver *resolver, const QString &hostName)
+        :resolver(resolver), hostName(hostName) {}
+    virtual void run() override
+    {
+        const QHostInfo &info = QHostInfo::fromName(hostName);
+        resolver->finish(hostName, info.addresses());
+    }
+private:
+    HostResolver *resolver;
+    QString hostName;
+};
+
+
+HostResolver::HostResolver()
+{
+    const int MaxResolverThreads = 8;
+    pool.setMaxThreadCount(MaxResolverThreads);
+}
+
+
+QList<QHostAddress> HostResolver::resolve(const QString &hostName)
+{
+    QSharedPointer<Event> done(new Event());
+    QSharedPointer<PendingLookup> lookup;
+    {
+        QMutexLocker locker(&mutex);
+        lookup = pending.value(hostName);
+        bool first = lookup.isNull();
+        if(first) {
+            lookup.reset(new PendingLookup());
+            pending.insert(hostName, lookup);
+        }
+        lookup->waiters.append(qMakePair(QPointer<EventLoopCoroutine>(EventLoopCoroutine::get()), done));
+        if(first) {
+            pool.start(new HostResolverTask(this, hostName));
+        }
+    }
+    done->wait();
+    QMutexLocker locker(&mutex);
+    return lookup->addresses;
+}
+
+
+void HostResolver::finish(const QString &hostName, const QList<QHostAddress> &addresses)
+{
+    QMutexLocker locker(&mutex);
+    QSharedPointer<PendingLookup> lookup = pending.take(hostName);
+    if(lookup.isNull()) {
+        return;
+    }
+    lookup->addresses = addresses;
+    for(int i = 0; i < lookup->waiters.size(); ++i) {
+        QPointer<EventLoopCoroutine> eventloop = lookup->waiters.at(i).first;
+        QSharedPointer<Event> done = lookup->waiters.at(i).second;
+        if(!eventloop.isNull()) {
+            eventloop->callLaterThreadSafe(0, new LambdaFunctor([done] {
+                done->set();
+            }));
+        }
+    }
+    lookup->waiters.clear();
+}
+
+}
+
+Q_GLOBAL_STATIC(HostResolver, hostResolver)
+
 QList<QHostAddress> Socket::resolve(const QString &hostName)
 {
 //    static QMap<QString, QList<QHostAddress>> cache;
@@ -475,16 +962,7 @@ QList<QHostAddress> Socket::resolve(const QString &hostName)
         return result;
     }
 
-    std::function<QHostInfo()> task = [hostName](){
-        const QHostInfo &info = QHostInfo::fromName(hostName);
-        return info;
-    };
-
-    QHostInfo hostInfo = callInThread<QHostInfo>(task);
-    //QHostInfo hostInfo = QHostInfo::fromName(hostName);
-    const QList<QHostAddress> &result = hostInfo.addresses();
-//    cache.insert(hostName, result);
-    return result;
+    return hostResolver()->resolve(hostName);
 }
 
 void Socket::setDnsCache(QSharedPointer<SocketDnsCache> dnsCache)
@@ -493,6 +971,32 @@ void Socket::setDnsCache(QSharedPointer<SocketDnsCache> dnsCache)
     d->dnsCache = dnsCache;
 }
 
+// the delay before the next address is tried while the last attempt is still connecting. RFC 8305 recommends 250ms.
+void Socket::setConnectAttemptDelay(int msecs)
+{
+    Q_D(Socket);
+    d->connectAttemptDelay = msecs;
+}
+
+int Socket::connectAttemptDelay() const
+{
+    Q_D(const Socket);
+    return d->connectAttemptDelay;
+}
+
+// the timeout of connecting to one address. 0 means the timeout of operating system.
+void Socket::setConnectTimeout(int msecs)
+{
+    Q_D(Socket);
+    d->connectTimeout = msecs;
+}
+
+int Socket::connectTimeout() const
+{
+    Q_D(const Socket);
+    return d->connectTimeout;
+}
+
 class PollPrivate
 {
 public:
@@ -624,17 +1128,86 @@ Socket *Poll::wait(qint64 msecs)
     return d->wait(msecs);
 }
 
+struct DnsCacheEntry
+{
+    QList<QHostAddress> addresses;
+    QDateTime expireAt;
+    int ttl;
+    int hits;
+};
+
 class SocketDnsCachePrivate
 {
 public:
-    SocketDnsCachePrivate()
-        :cache(1024)
-    {
+    SocketDnsCachePrivate();
+    ~SocketDnsCachePrivate();
+    QList<QHostAddress> cached(const QString &hostName, bool *found);
+    void update(const QString &hostName, bool refreshing);
+public:
+    QCache<QString, DnsCacheEntry> cache;
+    QMap<QString, QSharedPointer<Event>> pending;
+    QSharedPointer<DnsResolver> resolver;
+    CoroutineGroup *operations;
+    int defaultTtl;
+    int negativeTtl;
+    int maxTtl;
+    quint64 hits;
+    quint64 misses;
+};
+
+SocketDnsCachePrivate::SocketDnsCachePrivate()
+    :cache(1024), operations(new CoroutineGroup), defaultTtl(60), negativeTtl(5), maxTtl(60 * 60), hits(0), misses(0)
+{
+}
+
+SocketDnsCachePrivate::~SocketDnsCachePrivate()
+{
+    delete operations;
+}
 
+QList<QHostAddress> SocketDnsCachePrivate::cached(const QString &hostName, bool *found)
+{
+    DnsCacheEntry *entry = cache.object(hostName);
+    *found = entry && entry->expireAt > QDateTime::currentDateTimeUtc();
+    if(*found) {
+        return entry->addresses;
     }
+    return QList<QHostAddress>();
+}
 
-    QCache<QString, QList<QHostAddress>> cache;
-};
+void SocketDnsCachePrivate::update(const QString &hostName, bool refreshing)
+{
+    QSharedPointer<Event> done(new Event());
+    pending.insert(hostName, done);
+    try {
+        QList<QHostAddress> addresses;
+        quint32 ttl = 0;
+        if(resolver.isNull()) {
+            addresses = Socket::resolve(hostName);
+        } else {
+            addresses = resolver->resolve(hostName, &ttl);
+        }
+        // a failed refresh keeps the old addresses until they expire.
+        if(!refreshing || !addresses.isEmpty()) {
+            DnsCacheEntry *entry = new DnsCacheEntry();
+            entry->addresses = addresses;
+            if(addresses.isEmpty()) {
+                entry->ttl = ttl > 0 ? qMin(static_cast<int>(ttl), negativeTtl) : negativeTtl;
+            } else {
+                entry->ttl = ttl > 0 ? static_cast<int>(qMin(ttl, static_cast<quint32>(maxTtl))) : defaultTtl;
+            }
+            entry->expireAt = QDateTime::currentDateTimeUtc().addSecs(entry->ttl);
+            entry->hits = 0;
+            cache.insert(hostName, entry);
+        }
+    } catch(...) {
+        pending.remove(hostName);
+        done->set();
+        throw;
+    }
+    pending.remove(hostName);
+    done->set();
+}
 
 SocketDnsCache::SocketDnsCache()
     :d_ptr(new SocketDnsCachePrivate())
@@ -649,18 +1222,87 @@ SocketDnsCache::~SocketDnsCache()
 QList<QHostAddress> SocketDnsCache::resolve(const QString &hostName)
 {
     Q_D(SocketDnsCache);
-    if(d->cache.contains(hostName)) {
-        return *(d->cache.object(hostName));
-    }
-    QList<QHostAddress> *addresses = new QList<QHostAddress>();
-    *addresses = Socket::resolve(hostName);
-    if(addresses->isEmpty()) {
-        delete addresses;
-        return QList<QHostAddress>();
+    bool found = false;
+    QList<QHostAddress> addresses = d->cached(hostName, &found);
+    if(found) {
+        ++d->hits;
+        DnsCacheEntry *entry = d->cache.object(hostName);
+        ++entry->hits;
+        // refresh hot entries in background before they expire, so the following requests never wait for queries.
+        const int HotEntryHits = 2;
+        qint64 leftMsecs = QDateTime::currentDateTimeUtc().msecsTo(entry->expireAt);
+        if(entry->hits >= HotEntryHits && !entry->addresses.isEmpty() && leftMsecs * 5 < entry->ttl * 1000
+                && !d->pending.contains(hostName)) {
+            SocketDnsCachePrivate *p = d;
+            d->operations->spawn([p, hostName] {
+                p->update(hostName, true);
+            });
+        }
+        return addresses;
+    }
+
+    ++d->misses;
+    QSharedPointer<Event> done = d->pending.value(hostName);
+    if(done.isNull()) {
+        d->update(hostName, false);
     } else {
-        d->cache.insert(hostName, addresses);
-        return *addresses;
+        done->wait(); // the same host name is being resolved by another coroutine.
     }
+    return d->cached(hostName, &found);
+}
+
+quint64 SocketDnsCache::hits() const
+{
+    Q_D(const SocketDnsCache);
+    return d->hits;
+}
+
+quint64 SocketDnsCache::misses() const
+{
+    Q_D(const SocketDnsCache);
+    return d->misses;
+}
+
+void SocketDnsCache::setDefaultTtl(int secs)
+{
+    Q_D(SocketDnsCache);
+    d->defaultTtl = secs;
+}
+
+int SocketDnsCache::defaultTtl() const
+{
+    Q_D(const SocketDnsCache);
+    return d->defaultTtl;
+}
+
+void SocketDnsCache::setNegativeTtl(int secs)
+{
+    Q_D(SocketDnsCache);
+    d->negativeTtl = secs;
+}
+
+int SocketDnsCache::negativeTtl() const
+{
+    Q_D(const SocketDnsCache);
+    return d->negativeTtl;
+}
+
+void SocketDnsCache::clear()
+{
+    Q_D(SocketDnsCache);
+    d->cache.clear();
+}
+
+void SocketDnsCache::setResolver(QSharedPointer<DnsResolver> resolver)
+{
+    Q_D(SocketDnsCache);
+    d->resolver = resolver;
+}
+
+QSharedPointer<DnsResolver> SocketDnsCache::resolver() const
+{
+    Q_D(const SocketDnsCache);
+    return d->resolver;
 }
 
 QTNETWORKNG_NAMESPACE_END
@@ -4,9 +4,19 @@
 #include <errno.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
+#ifdef Q_OS_LINUX
+#include <sys/sendfile.h>
+#endif
+#include <limits.h>
 #include <net/if.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
+#ifdef Q_OS_LINUX
+#include <netinet/udp.h>
+#endif
+#include <QtCore/qvarlengtharray.h>
 #include "../include/socket_p.h"
 
 #ifndef SOCK_NONBLOCK
@@ -226,7 +236,6 @@ bool SocketPrivate::connect(const QHostAddress &address, quint16 port)
     QT_SOCKLEN_T sockAddrSize;
     setPortAndAddress(port, address, &aa, &sockAddrSize);
     state = Socket::ConnectingState;
-    ScopedIoWatcher watcher(EventLoopCoroutine::Write, fd);
     while(true)
     {
         if(!isValid())
@@ -298,18 +307,61 @@ bool SocketPrivate::connect(const QHostAddress &address, quint16 port)
             state = Socket::UnconnectedState;
             return false;
         }
-        watcher.start();
+        writeWatcher.wait(fd);
     }
 }
 
 
 
+// with TCP Fast Open, the data is sent in SYN if the kernel has a cookie of the server. otherwise, SYN asks for
+// a cookie, and the data is sent after the handshake as usual.
+qint64 SocketPrivate::connectAndSend(const QHostAddress &address, quint16 port, const char *data, qint64 size)
+{
+    if(!isValid())
+        return -1;
+    if(state != Socket::UnconnectedState && state != Socket::BoundState)
+        return -1;
+#if defined(Q_OS_LINUX) && defined(MSG_FASTOPEN)
+    if(type == Socket::TcpSocket && size > 0) {
+        qt_sockaddr aa;
+        QT_SOCKLEN_T sockAddrSize;
+        setPortAndAddress(port, address, &aa, &sockAddrSize);
+        ssize_t sent;
+        do {
+            sent = ::sendto(fd, data, static_cast<size_t>(size), MSG_FASTOPEN | MSG_NOSIGNAL, &aa.a, sockAddrSize);
+        } while(sent < 0 && errno == EINTR);
+        if(sent >= 0 || errno == EINPROGRESS) {
+            // wait for the handshake. connect() gets EALREADY until it is done.
+            state = Socket::ConnectingState;
+            if(!connectWithTimeout(address, port)) {
+                return -1;
+            }
+            if(sent < 0) {
+                sent = 0;
+            }
+            if(sent == size) {
+                return size;
+            }
+            qint64 rest = send(data + sent, size - sent, true);
+            return rest < 0 ? rest : sent + rest;
+        }
+        // fast open is disabled by sysctl net.ipv4.tcp_fastopen, or not supported.
+    }
+#endif
+    if(!connectWithTimeout(address, port)) {
+        return -1;
+    }
+    return send(data, size, true);
+}
+
 bool SocketPrivate::close()
 {
     if(fd > 0)
     {
         ::close(fd);
         EventLoopCoroutine::get()->triggerIoWatchers(fd);
+        readWatcher.reset();
+        writeWatcher.reset();
         fd = -1;
     }
     state = Socket::UnconnectedState;
@@ -427,7 +479,6 @@ qint64 SocketPrivate::recv(char *data, qint64 size, bool all)
     if(!isValid()) {
         return -1;
     }
-    ScopedIoWatcher watcher(EventLoopCoroutine::Read, fd);
     qint64 total = 0;
     while(total < size) {
         if(!isValid()) {
@@ -487,7 +538,7 @@ qint64 SocketPrivate::recv(char *data, qint64 size, bool all)
             total += r;
             if(all) continue; else return total;
         }
-        watcher.start();
+        readWatcher.wait(fd);
     }
     return total;
 }
@@ -503,7 +554,6 @@ qint64 SocketPrivate::send(const char *data, qint64 size, bool all)
         return 0;
     }
     qint64 sent = 0;
-    ScopedIoWatcher watcher(EventLoopCoroutine::Write, fd);
     // TODO UDP socket may send zero length packet
 
     while(sent < size)
@@ -551,11 +601,314 @@ qint64 SocketPrivate::send(const char *data, qint64 size, bool all)
                 return sent;
             }
         }
-        watcher.start();
+        writeWatcher.wait(fd);
     }
     return sent;
 }
 
+#ifndef IOV_MAX
+#define IOV_MAX 16
+#endif
+
+// writev() the buffers as they are, so a header and its body leave in one system call without joining them.
+qint64 SocketPrivate::sendv(const QList<QByteArray> &data)
+{
+    if(!isValid()) {
+        return 0;
+    }
+    qint64 sent = 0;
+    int index = 0;
+    qint64 offset = 0;
+    while(true)
+    {
+        while(index < data.size() && offset >= data.at(index).size()) {
+            ++index;
+            offset = 0;
+        }
+        if(index >= data.size()) {
+            return sent;
+        }
+        QVarLengthArray<struct iovec, 16> vecs;
+        for(int i = index; i < data.size() && vecs.size() < IOV_MAX; ++i) {
+            const QByteArray &buf = data.at(i);
+            qint64 skip = i == index ? offset : 0;
+            if(buf.size() > skip) {
+                struct iovec vec;
+                vec.iov_base = const_cast<char*>(buf.constData()) + skip;
+                vec.iov_len = buf.size() - skip;
+                vecs.append(vec);
+            }
+        }
+
+        ssize_t w;
+        do {
+            w = ::writev(fd, vecs.constData(), vecs.size());
+        } while(w < 0 && errno == EINTR);
+        if(w > 0) {
+            sent += w;
+            while(w > 0) {
+                qint64 left = data.at(index).size() - offset;
+                if(w >= left) {
+                    w -= left;
+                    ++index;
+                    offset = 0;
+                } else {
+                    offset += w;
+                    w = 0;
+                }
+            }
+            continue;
+        } else if(w < 0) {
+            switch(errno)
+            {
+#if EWOULDBLOCK-0 && EWOULDBLOCK != EAGAIN
+            case EWOULDBLOCK:
+#endif
+            case EAGAIN:
+                break;
+            case EACCES:
+                setError(Socket::SocketAccessError, AccessErrorString);
+                close();
+                return sent;
+            case EBADF:
+            case EFAULT:
+            case EINVAL:
+            case ENOTCONN:
+            case ENOTSOCK:
+                setError(Socket::UnsupportedSocketOperationError, InvalidSocketErrorString);
+                close();
+                return sent;
+            case ENOBUFS:
+            case ENOMEM:
+                setError(Socket::SocketResourceError, ResourceErrorString);
+                return sent;
+            case EPIPE:
+            case ECONNRESET:
+                setError(Socket::RemoteHostClosedError, RemoteHostClosedErrorString);
+                close();
+                return sent;
+            default:
+                setError(Socket::UnknownSocketError, UnknownSocketErrorString);
+                close();
+                return sent;
+            }
+        }
+        writeWatcher.wait(fd);
+    }
+}
+
+// readv() once, filling the buffers in order. the buffers are not resized.
+qint64 SocketPrivate::recvv(QList<QByteArray> &buffers)
+{
+    if(!isValid()) {
+        return -1;
+    }
+    if(type != Socket::TcpSocket || state != Socket::ConnectedState) {
+        setError(Socket::UnsupportedSocketOperationError, OperationUnsupportedErrorString);
+        return -1;
+    }
+    QVarLengthArray<struct iovec, 16> vecs;
+    for(int i = 0; i < buffers.size() && vecs.size() < IOV_MAX; ++i) {
+        QByteArray &buf = buffers[i];
+        if(!buf.isEmpty()) {
+            struct iovec vec;
+            vec.iov_base = buf.data();
+            vec.iov_len = buf.size();
+            vecs.append(vec);
+        }
+    }
+    if(vecs.isEmpty()) {
+        return 0;
+    }
+    while(true)
+    {
+        ssize_t r;
+        do {
+            r = ::readv(fd, vecs.constData(), vecs.size());
+        } while(r < 0 && errno == EINTR);
+        if(r > 0) {
+            return r;
+        } else if(r == 0) {
+            setError(Socket::RemoteHostClosedError, RemoteHostClosedErrorString);
+            close();
+            return 0;
+        }
+        switch (errno) {
+#if EWOULDBLOCK-0 && EWOULDBLOCK != EAGAIN
+        case EWOULDBLOCK:
+#endif
+        case EAGAIN:
+            break;
+        case ECONNRESET:
+            setError(Socket::RemoteHostClosedError, RemoteHostClosedErrorString);
+            close();
+            return 0;
+        default:
+            setError(Socket::NetworkError, InvalidSocketErrorString);
+            close();
+            return -1;
+        }
+        readWatcher.wait(fd);
+    }
+}
+
+// sendfile() copies the page cache to the socket inside the kernel. pread() and send() are used where it is not available,
+// or the file can not be mapped, such as a pipe.
+qint64 SocketPrivate::sendfile(int fileDescriptor, qint64 offset, qint64 length)
+{
+    if(!isValid()) {
+        return -1;
+    }
+    if(length < 0) {
+        struct stat st;
+        if(::fstat(fileDescriptor, &st) != 0) {
+            return -1;
+        }
+        length = qMax<qint64>(st.st_size - offset, 0);
+    }
+    qint64 sent = 0;
+#ifdef Q_OS_LINUX
+    while(sent < length) {
+        off_t off = offset + sent;
+        ssize_t w = ::sendfile(fd, fileDescriptor, &off, static_cast<size_t>(qMin<qint64>(length - sent, 0x7ffff000)));
+        if(w > 0) {
+            sent += w;
+            continue;
+        } else if(w == 0) {
+            // the file is shorter than expected.
+            return sent;
+        }
+        switch(errno) {
+        case EINTR:
+            continue;
+#if EWOULDBLOCK-0 && EWOULDBLOCK != EAGAIN
+        case EWOULDBLOCK:
+#endif
+        case EAGAIN:
+            writeWatcher.wait(fd);
+            continue;
+        case EPIPE:
+        case ECONNRESET:
+            setError(Socket::RemoteHostClosedError, RemoteHostClosedErrorString);
+            close();
+            return sent;
+        case EINVAL:
+        case ENOSYS:
+            break;
+        default:
+            return sent == 0 ? -1 : sent;
+        }
+        break;
+    }
+#endif
+    QByteArray buf(64 * 1024, Qt::Uninitialized);
+    while(sent < length) {
+        ssize_t r = ::pread(fileDescriptor, buf.data(), static_cast<size_t>(qMin<qint64>(length - sent, buf.size())), offset + sent);
+        if(r < 0 && errno == EINTR) {
+            continue;
+        } else if(r <= 0) {
+            break;
+        }
+        qint64 w = send(buf.constData(), r, true);
+        if(w > 0) {
+            sent += w;
+        }
+        if(w != r) {
+            break;
+        }
+    }
+    return sent;
+}
+
+// relay the data from `source` to this socket. on linux, the data moves through a pipe by splice() and never enters user space.
+qint64 SocketPrivate::splice(SocketPrivate *source, qint64 length)
+{
+    if(!isValid() || !source->isValid()) {
+        return -1;
+    }
+    const qint64 ChunkSize = 64 * 1024;
+    qint64 moved = 0;
+#ifdef Q_OS_LINUX
+    int pipefd[2];
+    if(::pipe2(pipefd, O_NONBLOCK | O_CLOEXEC) == 0) {
+        bool fallback = false;
+        bool done = false;
+        while(!done && (length < 0 || moved < length)) {
+            qint64 chunk = length < 0 ? ChunkSize : qMin(ChunkSize, length - moved);
+            ssize_t r = ::splice(source->fd, 0, pipefd[1], 0, static_cast<size_t>(chunk), SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if(r == 0) {
+                break;
+            } else if(r < 0) {
+                switch(errno) {
+                case EINTR:
+                    continue;
+#if EWOULDBLOCK-0 && EWOULDBLOCK != EAGAIN
+                case EWOULDBLOCK:
+#endif
+                case EAGAIN:
+                    source->readWatcher.wait(source->fd);
+                    continue;
+                case EINVAL:
+                    fallback = moved == 0;
+                    break;
+                case ECONNRESET:
+                    source->setError(Socket::RemoteHostClosedError, RemoteHostClosedErrorString);
+                    source->close();
+                    break;
+                default:
+                    source->setError(Socket::NetworkError, InvalidSocketErrorString);
+                    source->close();
+                    break;
+                }
+                break;
+            }
+            // drain the pipe before reading more, so it never fills up.
+            while(r > 0) {
+                ssize_t w = ::splice(pipefd[0], 0, fd, 0, static_cast<size_t>(r), SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+                if(w > 0) {
+                    r -= w;
+                    moved += w;
+                } else if(w < 0 && errno == EINTR) {
+                    continue;
+                } else if(w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    writeWatcher.wait(fd);
+                } else {
+                    if(w < 0 && (errno == EPIPE || errno == ECONNRESET)) {
+                        setError(Socket::RemoteHostClosedError, RemoteHostClosedErrorString);
+                    } else {
+                        setError(Socket::NetworkError, InvalidSocketErrorString);
+                    }
+                    close();
+                    done = true;
+                    break;
+                }
+            }
+        }
+        ::close(pipefd[0]);
+        ::close(pipefd[1]);
+        if(!fallback) {
+            return moved;
+        }
+    }
+#endif
+    QByteArray buf(ChunkSize, Qt::Uninitialized);
+    while(length < 0 || moved < length) {
+        qint64 chunk = length < 0 ? ChunkSize : qMin(ChunkSize, length - moved);
+        qint64 r = source->recv(buf.data(), chunk, false);
+        if(r <= 0) {
+            break;
+        }
+        qint64 w = send(buf.constData(), r, true);
+        if(w > 0) {
+            moved += w;
+        }
+        if(w != r) {
+            break;
+        }
+    }
+    return moved;
+}
+
 qint64 SocketPrivate::recvfrom(char *data, qint64 maxSize, QHostAddress *addr, quint16 *port)
 {
     if(!isValid()) {
@@ -579,7 +932,6 @@ qint64 SocketPrivate::recvfrom(char *data, qint64 maxSize, QHostAddress *addr, q
     msg.msg_namelen = sizeof(aa);
 
     ssize_t recvResult = 0;
-    ScopedIoWatcher watcher(EventLoopCoroutine::Read, fd);
     while(true)
     {
         do {
@@ -623,7 +975,7 @@ qint64 SocketPrivate::recvfrom(char *data, qint64 maxSize, QHostAddress *addr, q
             //return qint64(maxSize ? recvResult : recvResult == -1 ? -1 : 0);
             return qint64(recvResult);
         }
-        watcher.start();
+        readWatcher.wait(fd);
     }
 }
 
@@ -649,7 +1001,6 @@ qint64 SocketPrivate::sendto(const char *data, qint64 size, const QHostAddress &
     msg.msg_namelen = len;
 
     ssize_t sentBytes = 0;
-    ScopedIoWatcher watcher(EventLoopCoroutine::Write, fd);
 #ifdef MSG_NOSIGNAL
     int flags = MSG_NOSIGNAL;
 #else
@@ -704,11 +1055,306 @@ qint64 SocketPrivate::sendto(const char *data, qint64 size, const QHostAddress &
         {
             return qint64(sentBytes);
         }
-        watcher.start();
+        writeWatcher.wait(fd);
     }
 }
 
 
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+#if defined(Q_OS_LINUX) && !defined(UDP_SEGMENT)
+#define UDP_SEGMENT 103
+#endif
+#if defined(Q_OS_LINUX) && !defined(UDP_GRO)
+#define UDP_GRO 104
+#endif
+
+// recvmmsg() and sendmmsg() are Linux only. other systems call recvmsg() and sendmsg() in a loop.
+#ifdef Q_OS_LINUX
+typedef struct mmsghdr qt_mmsghdr;
+#else
+struct qt_mmsghdr
+{
+    struct msghdr msg_hdr;
+    unsigned int msg_len;
+};
+#endif
+
+static int qt_recvmmsg(int fd, qt_mmsghdr *msgs, unsigned int count)
+{
+    int r;
+#ifdef Q_OS_LINUX
+    do {
+        r = ::recvmmsg(fd, msgs, count, 0, 0);
+    } while(r == -1 && errno == EINTR);
+#else
+    for(r = 0; r < static_cast<int>(count); ++r) {
+        ssize_t bytes;
+        do {
+            bytes = ::recvmsg(fd, &msgs[r].msg_hdr, 0);
+        } while(bytes == -1 && errno == EINTR);
+        if(bytes < 0) {
+            return r > 0 ? r : -1;
+        }
+        msgs[r].msg_len = static_cast<unsigned int>(bytes);
+    }
+#endif
+    return r;
+}
+
+static int qt_sendmmsg(int fd, qt_mmsghdr *msgs, unsigned int count)
+{
+#ifdef MSG_NOSIGNAL
+    int flags = MSG_NOSIGNAL;
+#else
+    int flags = 0;
+#endif
+    int r;
+#ifdef Q_OS_LINUX
+    do {
+        r = ::sendmmsg(fd, msgs, count, flags);
+    } while(r == -1 && errno == EINTR);
+#else
+    for(r = 0; r < static_cast<int>(count); ++r) {
+        ssize_t bytes;
+        do {
+            bytes = ::sendmsg(fd, &msgs[r].msg_hdr, flags);
+        } while(bytes == -1 && errno == EINTR);
+        if(bytes < 0) {
+            return r > 0 ? r : -1;
+        }
+        msgs[r].msg_len = static_cast<unsigned int>(bytes);
+    }
+#endif
+    return r;
+}
+
+// the control message of UDP_GRO carries an int, and UDP_SEGMENT takes an u16.
+static const int ControlWords = static_cast<int>((CMSG_SPACE(sizeof(int)) + sizeof(quint64) - 1) / sizeof(quint64));
+
+int SocketPrivate::recvmany(DatagramBatch *batch)
+{
+    if(!isValid()) {
+        return -1;
+    }
+    DatagramBatchPrivate *b = batch->d_ptr;
+    b->entries.clear();
+    b->used = 0;
+    // a datagram merged by GRO may be as large as 64KB, the smaller slots would cut it silently.
+    if(udpGro && b->datagramSize < 0xffff) {
+        setError(Socket::DatagramTooLargeError, DatagramTooLargeErrorString);
+        return -1;
+    }
+
+    const int count = b->capacity;
+    QVarLengthArray<qt_mmsghdr, 64> msgs(count);
+    QVarLengthArray<struct iovec, 64> vecs(count);
+    QVarLengthArray<qt_sockaddr, 64> names(count);
+    QVarLengthArray<quint64, 64 * 4> controls(count * ControlWords);
+
+    while(true) {
+        memset(msgs.data(), 0, sizeof(qt_mmsghdr) * static_cast<size_t>(count));
+        for(int i = 0; i < count; ++i) {
+            vecs[i].iov_base = b->arena.data() + i * b->datagramSize;
+            vecs[i].iov_len = static_cast<size_t>(b->datagramSize);
+            struct msghdr &msg = msgs[i].msg_hdr;
+            msg.msg_iov = &vecs[i];
+            msg.msg_iovlen = 1;
+            msg.msg_name = &names[i];
+            msg.msg_namelen = sizeof(qt_sockaddr);
+            msg.msg_control = controls.data() + i * ControlWords;
+            msg.msg_controllen = ControlWords * sizeof(quint64);
+        }
+
+        int n = qt_recvmmsg(fd, msgs.data(), static_cast<unsigned int>(count));
+        if(n < 0) {
+            switch (errno) {
+#if EWOULDBLOCK-0 && EWOULDBLOCK != EAGAIN
+            case EWOULDBLOCK:
+#endif
+            case EAGAIN:
+                break;
+            case ECONNRESET:
+            case ECONNREFUSED:
+            case ENOTCONN:
+                if(type == Socket::TcpSocket) {
+                    setError(Socket::RemoteHostClosedError, RemoteHostClosedErrorString);
+                    close();
+                }
+                return -1;
+            case ENOMEM:
+                setError(Socket::SocketResourceError, ResourceErrorString);
+                return -1;
+            default:
+                setError(Socket::NetworkError, InvalidSocketErrorString);
+                close();
+                return -1;
+            }
+        } else {
+            for(int i = 0; i < n; ++i) {
+                DatagramBatchPrivate::Entry entry;
+                entry.port = 0;
+                qt_socket_getPortAndAddress(&names[i], &entry.port, &entry.addr);
+                entry.truncated = false;
+                const int length = static_cast<int>(msgs[i].msg_len);
+                int segmentSize = length;
+#ifdef Q_OS_LINUX
+                // with UDP_GRO, the kernel merges datagrams of the same flow. split them again.
+                struct msghdr *msg = &msgs[i].msg_hdr;
+                for(struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+                    if(cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+                        int gso = 0;
+                        memcpy(&gso, CMSG_DATA(cmsg), sizeof(gso));
+                        if(gso > 0) {
+                            segmentSize = gso;
+                        }
+                    }
+                }
+#endif
+                // splitting may return more datagrams than the capacity of batch.
+                int offset = 0;
+                do {
+                    entry.offset = i * b->datagramSize + offset;
+                    entry.length = qMin(segmentSize, length - offset);
+                    b->entries.append(entry);
+                    offset += segmentSize;
+                } while(offset < length);
+                if(msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+                    b->entries.last().truncated = true;
+                }
+            }
+            b->used = n * b->datagramSize;
+            return b->entries.size();
+        }
+        readWatcher.wait(fd);
+    }
+}
+
+int SocketPrivate::sendmany(const DatagramBatch *batch)
+{
+    if(!isValid()) {
+        return -1;
+    }
+    const DatagramBatchPrivate *b = batch->d_ptr;
+    const int total = b->entries.size();
+    if(total == 0) {
+        return 0;
+    }
+    // the kernel takes 64 segments at most for one GSO send, and the whole buffer must fit in one UDP packet.
+    const int MaxGsoSegments = 64;
+    const int MaxGsoBytes = 65000;
+
+    QVarLengthArray<qt_mmsghdr, 64> msgs(total);
+    QVarLengthArray<struct iovec, 64> vecs(total);
+    QVarLengthArray<qt_sockaddr, 64> names(total);
+    QVarLengthArray<quint64, 64 * 4> controls(total * ControlWords);
+    QVarLengthArray<int, 64> segments(total);
+
+    int sent = 0;
+    while(sent < total) {
+        memset(msgs.data(), 0, sizeof(qt_mmsghdr) * static_cast<size_t>(total));
+        int count = 0;
+        for(int i = sent; i < total; ++count) {
+            const DatagramBatchPrivate::Entry &entry = b->entries.at(i);
+            int n = 1;
+            int bytes = entry.length;
+#ifdef Q_OS_LINUX
+            // a run of datagrams to the same peer, of the same size except the last one, is sent as one buffer.
+            if(udpGso && entry.length > 0) {
+                while(i + n < total && n < MaxGsoSegments) {
+                    const DatagramBatchPrivate::Entry &last = b->entries.at(i + n - 1);
+                    const DatagramBatchPrivate::Entry &next = b->entries.at(i + n);
+                    if(last.length != entry.length || next.offset != last.offset + last.length
+                            || next.length == 0 || next.length > entry.length || bytes + next.length > MaxGsoBytes
+                            || next.port != entry.port || next.addr != entry.addr) {
+                        break;
+                    }
+                    bytes += next.length;
+                    ++n;
+                }
+            }
+#endif
+            vecs[count].iov_base = const_cast<char*>(b->arena.constData()) + entry.offset;
+            vecs[count].iov_len = static_cast<size_t>(bytes);
+            struct msghdr &msg = msgs[count].msg_hdr;
+            msg.msg_iov = &vecs[count];
+            msg.msg_iovlen = 1;
+            // a connected socket may send datagrams without address.
+            if(!entry.addr.isNull()) {
+                if(count > 0 && entry.port == b->entries.at(i - 1).port && entry.addr == b->entries.at(i - 1).addr) {
+                    names[count] = names[count - 1];
+                    msg.msg_namelen = msgs[count - 1].msg_hdr.msg_namelen;
+                } else {
+                    QT_SOCKLEN_T len;
+                    setPortAndAddress(entry.port, entry.addr, &names[count], &len);
+                    msg.msg_namelen = len;
+                }
+                msg.msg_name = &names[count];
+            }
+#ifdef Q_OS_LINUX
+            if(n > 1) {
+                msg.msg_control = controls.data() + count * ControlWords;
+                msg.msg_controllen = CMSG_SPACE(sizeof(quint16));
+                struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+                cmsg->cmsg_level = SOL_UDP;
+                cmsg->cmsg_type = UDP_SEGMENT;
+                cmsg->cmsg_len = CMSG_LEN(sizeof(quint16));
+                quint16 segmentSize = static_cast<quint16>(entry.length);
+                memcpy(CMSG_DATA(cmsg), &segmentSize, sizeof(segmentSize));
+            }
+#endif
+            segments[count] = n;
+            i += n;
+        }
+
+        int r = qt_sendmmsg(fd, msgs.data(), static_cast<unsigned int>(count));
+        if(r > 0) {
+            for(int k = 0; k < r; ++k) {
+                sent += segments[k];
+            }
+            continue;
+        }
+        switch(errno) {
+#if EWOULDBLOCK-0 && EWOULDBLOCK != EAGAIN
+        case EWOULDBLOCK:
+#endif
+        case EAGAIN:
+            break;
+        case EIO:
+        case EINVAL:
+            // the kernel or the device does not support GSO, send datagrams one by one.
+            if(udpGso) {
+                udpGso = false;
+                continue;
+            }
+            setError(Socket::NetworkError, InvalidSocketErrorString);
+            return sent > 0 ? sent : -1;
+        case EACCES:
+            setError(Socket::SocketAccessError, AccessErrorString);
+            return sent > 0 ? sent : -1;
+        case EMSGSIZE:
+            setError(Socket::DatagramTooLargeError, DatagramTooLargeErrorString);
+            return sent > 0 ? sent : -1;
+        case EDESTADDRREQ:
+        case EISCONN:
+        case ENOTCONN:
+            setError(Socket::UnsupportedSocketOperationError, InvalidSocketErrorString);
+            return sent > 0 ? sent : -1;
+        case ENOBUFS:
+        case ENOMEM:
+            setError(Socket::SocketResourceError, ResourceErrorString);
+            return sent > 0 ? sent : -1;
+        default:
+            setError(Socket::NetworkError, InvalidSocketErrorString);
+            return sent > 0 ? sent : -1;
+        }
+        writeWatcher.wait(fd);
+    }
+    return sent;
+}
+
+
 static void convertToLevelAndOption(Socket::SocketOption opt,
                                     Socket::NetworkLayerProtocol socketProtocol, int *level, int *n)
 {
@@ -793,8 +1439,32 @@ static void convertToLevelAndOption(Socket::SocketOption opt,
     case Socket::MaxStreamsSocketOption:
         // FIXME support stcp
         break;
+    case Socket::ReusePortOption:
+#ifdef SO_REUSEPORT
+        *n = SO_REUSEPORT;
+#endif
+        break;
+    case Socket::TcpFastOpenOption:
+#ifdef TCP_FASTOPEN
+        *level = IPPROTO_TCP;
+        *n = TCP_FASTOPEN;
+#endif
+        break;
+    case Socket::DeferAcceptOption:
+#ifdef TCP_DEFER_ACCEPT
+        *level = IPPROTO_TCP;
+        *n = TCP_DEFER_ACCEPT;
+#endif
+        break;
+    case Socket::UdpGroOption:
+#ifdef UDP_GRO
+        *level = SOL_UDP;
+        *n = UDP_GRO;
+#endif
+        break;
     case Socket::NonBlockingSocketOption:
     case Socket::BindExclusively:
+    case Socket::UdpGsoOption:
         Q_UNREACHABLE();
     }
 }
@@ -808,6 +1478,9 @@ QVariant SocketPrivate::option(Socket::SocketOption option) const
     if(option == Socket::BroadcastSocketOption) {
         return QVariant(true);
     }
+    if(option == Socket::UdpGsoOption) {
+        return QVariant(udpGso ? 1 : 0);
+    }
     int n, level;
     int v = -1;
     QT_SOCKLEN_T len = sizeof(v);
@@ -835,7 +1508,32 @@ bool SocketPrivate::setOption(Socket::SocketOption option, const QVariant &value
     if(!ok)
         return false;
 
+    // GSO is requested for every sendmany() by a control message, instead of UDP_SEGMENT for the whole socket.
+    if(option == Socket::UdpGsoOption) {
+#if defined(Q_OS_LINUX)
+        if(type != Socket::UdpSocket) {
+            return false;
+        }
+        udpGso = v != 0;
+        return true;
+#else
+        return false;
+#endif
+    }
+
     convertToLevelAndOption(option, protocol, &level, &n);
+    if(n == -1) {
+        return false;
+    }
+
+    // recvmany() must know whether the kernel merges datagrams.
+    if(option == Socket::UdpGroOption) {
+        if(::setsockopt(fd, level, n, reinterpret_cast<char*>(&v), sizeof(v)) != 0) {
+            return false;
+        }
+        udpGro = v != 0;
+        return true;
+    }
 
 #if defined(SO_REUSEPORT) && !defined(Q_OS_LINUX)
     if (option == Socket::AddressReusable) {
@@ -874,7 +1572,7 @@ static inline int qt_safe_accept(int s, struct sockaddr *addr, socklen_t *addrle
     Q_ASSERT((flags & ~O_NONBLOCK) == 0);
 
     int fd;
-#if QT_UNIX_SUPPORTS_THREADSAFE_CLOEXEC && defined(SOCK_CLOEXEC) && defined(SOCK_NONBLOCK)
+#if (QT_UNIX_SUPPORTS_THREADSAFE_CLOEXEC || defined(Q_OS_LINUX)) && defined(SOCK_CLOEXEC) && defined(SOCK_NONBLOCK)
     // use accept4
     int sockflags = SOCK_CLOEXEC;
     if (flags & O_NONBLOCK)
@@ -899,65 +1597,106 @@ static inline int qt_safe_accept(int s, struct sockaddr *addr, socklen_t *addrle
 
 Socket *SocketPrivate::accept()
 {
-    if(!isValid()) {
+    const QList<Socket*> &sockets = acceptMany(1);
+    if(sockets.isEmpty()) {
         return 0;
     }
+    return sockets.first();
+}
+
+
+// the peer address comes from accept(), and the local address from the listening socket unless it is a wildcard.
+Socket *SocketPrivate::makeAcceptedSocket(qintptr acceptedDescriptor, const qt_sockaddr *peer)
+{
+    SocketPrivate *d = new SocketPrivate(acceptedDescriptor, this);
+    if(peer->a.sa_family == AF_INET) {
+        d->protocol = Socket::IPv4Protocol;
+        qt_socket_getPortAndAddress(peer, &d->peerPort, &d->peerAddress);
+    } else if(peer->a.sa_family == AF_INET6) {
+        d->protocol = Socket::IPv6Protocol;
+        qt_socket_getPortAndAddress(peer, &d->peerPort, &d->peerAddress);
+    }
+    if(localAddress.isNull() || localAddress == QHostAddress::Any || localAddress == QHostAddress::AnyIPv4
+            || localAddress == QHostAddress::AnyIPv6) {
+        qt_sockaddr sa;
+        QT_SOCKLEN_T sockAddrSize = sizeof(sa);
+        memset(&sa, 0, sizeof(sa));
+        if(::getsockname(acceptedDescriptor, &sa.a, &sockAddrSize) == 0) {
+            qt_socket_getPortAndAddress(&sa, &d->localPort, &d->localAddress);
+        }
+    }
+    return new Socket(d);
+}
+
+
+// accept4() until the backlog is drained, so a burst of clients costs one wakeup instead of one per connection.
+QList<Socket*> SocketPrivate::acceptMany(int maxCount)
+{
+    QList<Socket*> sockets;
+    if(!isValid() || maxCount <= 0) {
+        return sockets;
+    }
 
     if(state != Socket::ListeningState || type != Socket::TcpSocket) {
-        return 0;
+        return sockets;
     }
 
-    ScopedIoWatcher watcher(EventLoopCoroutine::Read, fd);
     while(true)
     {
-        int acceptedDescriptor = qt_safe_accept(fd, 0, 0);
+        qt_sockaddr sa;
+        QT_SOCKLEN_T sockAddrSize = sizeof(sa);
+        int acceptedDescriptor = qt_safe_accept(fd, &sa.a, &sockAddrSize, O_NONBLOCK);
         if (acceptedDescriptor == -1) {
+            if(errno == EAGAIN || errno == EWOULDBLOCK) {
+                if(!sockets.isEmpty()) {
+                    return sockets;
+                }
+                readWatcher.wait(fd);
+                continue;
+            }
+            if(errno == ECONNABORTED || errno == EINTR) {
+                continue;
+            }
+            // return the connections accepted already, the error is reported by next call.
+            if(!sockets.isEmpty()) {
+                return sockets;
+            }
             switch (errno) {
             case EBADF:
             case EOPNOTSUPP:
                 setError(Socket::UnsupportedSocketOperationError, InvalidSocketErrorString);
-                return 0;
-            case ECONNABORTED:
-                setError(Socket::NetworkError, RemoteHostClosedErrorString);
-                return 0;
+                break;
             case EFAULT:
             case ENOTSOCK:
                 setError(Socket::SocketResourceError, NotSocketErrorString);
-                return 0;
+                break;
             case EPROTONOSUPPORT:
             case EPROTO:
             case EAFNOSUPPORT:
             case EINVAL:
                 setError(Socket::UnsupportedSocketOperationError, ProtocolUnsupportedErrorString);
-                return 0;
+                break;
             case ENFILE:
             case EMFILE:
             case ENOBUFS:
             case ENOMEM:
                 setError(Socket::SocketResourceError, ResourceErrorString);
-                return 0;
+                break;
             case EACCES:
             case EPERM:
                 setError(Socket::SocketAccessError, AccessErrorString);
-                return 0;
+                break;
             default:
                 setError(Socket::UnknownSocketError, UnknownSocketErrorString);
-                return 0;
-#if EAGAIN != EWOULDBLOCK
-            case EWOULDBLOCK:
-#endif
-            case EAGAIN:
                 break;
             }
+            return sockets;
         }
-        else
-        {
-            Socket *conn = new Socket(acceptedDescriptor);
-            return conn;
+        sockets.append(makeAcceptedSocket(acceptedDescriptor, &sa));
+        if(sockets.size() >= maxCount) {
+            return sockets;
         }
-        watcher.start();
     }
 }
 
-
 QTNETWORKNG_NAMESPACE_END
@@ -1,4 +1,6 @@
+#include <string.h>
 #include "../include/socket_utils.h"
+#include "../include/coroutine_utils.h"
 
 QTNETWORKNG_NAMESPACE_BEGIN
 
@@ -44,6 +46,8 @@ public:
     virtual QByteArray recvall(qint64 size) override;
     virtual qint64 send(const QByteArray &data) override;
     virtual qint64 sendall(const QByteArray &data) override;
+    virtual qint64 sendv(const QList<QByteArray> &data) override;
+    virtual qint64 recvv(QList<QByteArray> &buffers) override;
 private:
     QSharedPointer<Socket> s;
 };
@@ -201,6 +205,16 @@ qint64 SocketLikeImpl::sendall(const QByteArray &data)
     return s->sendall(data);
 }
 
+qint64 SocketLikeImpl::sendv(const QList<QByteArray> &data)
+{
+    return s->sendv(data);
+}
+
+qint64 SocketLikeImpl::recvv(QList<QByteArray> &buffers)
+{
+    return s->recvv(buffers);
+}
+
 } //anonymous namespace
 
 QSharedPointer<SocketLike> SocketLike::rawSocket(QSharedPointer<Socket> s)
@@ -208,4 +222,174 @@ QSharedPointer<SocketLike> SocketLike::rawSocket(QSharedPointer<Socket> s)
     return QSharedPointer<SocketLikeImpl>::create(s).dynamicCast<SocketLike>();
 }
 
+
+// 开始实现 SocketBuffer
+
+SocketBuffer::SocketBuffer(QSharedPointer<SocketLike> connection, int capacity)
+    :conn(connection), storage(qMax(capacity, 16), Qt::Uninitialized), head(0), count(0)
+{
+}
+
+
+// one recv() into the larger free segment. the buffer doubles if it is full.
+qint64 SocketBuffer::receive()
+{
+    if(conn.isNull()) {
+        return -1;
+    }
+    if(count == storage.size()) {
+        reserve(storage.size() * 2);
+    }
+    const int cap = storage.size();
+    const int tail = (head + count) % cap;
+    const int space = tail >= head ? cap - tail : head - tail;
+    qint64 bytes = conn->recv(storage.data() + tail, space);
+    if(bytes > 0) {
+        count += static_cast<int>(bytes);
+    }
+    return bytes;
+}
+
+
+bool SocketBuffer::fill(int size)
+{
+    if(size > storage.size()) {
+        reserve(size);
+    }
+    while(count < size) {
+        if(receive() <= 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+int SocketBuffer::indexOf(char c, int maxLength) const
+{
+    int length = maxLength < 0 ? count : qMin(count, maxLength);
+    const int cap = storage.size();
+    const char *data = storage.constData();
+    int first = qMin(length, cap - head);
+    const char *found = static_cast<const char*>(memchr(data + head, c, static_cast<size_t>(first)));
+    if(found) {
+        return static_cast<int>(found - data - head);
+    }
+    if(length > first) {
+        found = static_cast<const char*>(memchr(data, c, static_cast<size_t>(length - first)));
+        if(found) {
+            return first + static_cast<int>(found - data);
+        }
+    }
+    return -1;
+}
+
+
+// the returned line contains the line break. an empty line means the connection is closed, or the line is too long.
+QByteArray SocketBuffer::readLine(int maxLength)
+{
+    while(true) {
+        int i = indexOf('\n', maxLength);
+        if(i >= 0) {
+            return read(i + 1);
+        }
+        if(maxLength >= 0 && count >= maxLength) {
+            return QByteArray();
+        }
+        if(receive() <= 0) {
+            return QByteArray();
+        }
+    }
+}
+
+
+QByteArray SocketBuffer::peek(int size) const
+{
+    size = qBound(0, size, count);
+    QByteArray result(size, Qt::Uninitialized);
+    const int cap = storage.size();
+    int first = qMin(size, cap - head);
+    memcpy(result.data(), storage.constData() + head, static_cast<size_t>(first));
+    if(size > first) {
+        memcpy(result.data() + first, storage.constData(), static_cast<size_t>(size - first));
+    }
+    return result;
+}
+
+
+QByteArray SocketBuffer::read(int size)
+{
+    const QByteArray &result = peek(size);
+    consume(result.size());
+    return result;
+}
+
+
+void SocketBuffer::consume(int size)
+{
+    size = qBound(0, size, count);
+    head = (head + size) % storage.size();
+    count -= size;
+    // start from the beginning again, so the next receive() gets the largest free segment.
+    if(count == 0) {
+        head = 0;
+    }
+}
+
+
+void SocketBuffer::append(const char *data, int size)
+{
+    if(size <= 0) {
+        return;
+    }
+    if(count + size > storage.size()) {
+        reserve(qMax(count + size, storage.size() * 2));
+    }
+    const int cap = storage.size();
+    const int tail = (head + count) % cap;
+    int first = qMin(size, cap - tail);
+    memcpy(storage.data() + tail, data, static_cast<size_t>(first));
+    if(size > first) {
+        memcpy(storage.data(), data + first, static_cast<size_t>(size - first));
+    }
+    count += size;
+}
+
+
+void SocketBuffer::clear()
+{
+    head = 0;
+    count = 0;
+}
+
+
+void SocketBuffer::reserve(int size)
+{
+    if(size <= storage.size()) {
+        return;
+    }
+    QByteArray newStorage = peek(count);
+    newStorage.resize(size);
+    storage = newStorage;
+    head = 0;
+}
+
+
+void acceptLoop(Socket *server, CoroutineGroup *operations, const std::function<void(QSharedPointer<Socket>)> &handler,
+                int batchSize)
+{
+    while(true) {
+        const QList<Socket*> &sockets = server->acceptMany(batchSize);
+        if(sockets.isEmpty()) {
+            return;
+        }
+        for(Socket *socket: sockets) {
+            QSharedPointer<Socket> request(socket);
+            operations->spawn([handler, request] {
+                handler(request);
+            });
+        }
+    }
+}
+
 QTNETWORKNG_NAMESPACE_END
@@ -3,6 +3,7 @@
 #include <ws2tcpip.h>
 #include <mswsock.h>
 #include <QtCore/qsysinfo.h>
+#include <QtCore/qfile.h>
 #include <QtNetwork/qnetworkinterface.h>
 #include "../include/socket_p.h"
 
@@ -230,6 +231,11 @@ static void convertToLevelAndOption(Socket::SocketOption opt,
     case Socket::NonBlockingSocketOption:      // WSAIoctl
     case Socket::TypeOfServiceOption:          // not supported
     case Socket::MaxStreamsSocketOption:
+    case Socket::ReusePortOption:
+    case Socket::UdpGsoOption:
+    case Socket::UdpGroOption:
+    case Socket::TcpFastOpenOption:
+    case Socket::DeferAcceptOption:
         Q_UNREACHABLE();
 
     case Socket::ReceiveBufferSizeSocketOption:
@@ -539,7 +545,6 @@ bool SocketPrivate::connect(const QHostAddress &address, quint16 port)
     }
 
     state = Socket::ConnectingState;
-    ScopedIoWatcher watcher(EventLoopCoroutine::Write, fd);
     while(true) {
         if(!isValid())
             return false;
@@ -645,18 +650,29 @@ bool SocketPrivate::connect(const QHostAddress &address, quint16 port)
                 setError(Socket::UnknownSocketError, UnknownSocketErrorString);
                 return false;
             }
-            watcher.start();
+            writeWatcher.wait(fd);
         }
     }
 }
 
 
+// TCP Fast Open on Windows needs ConnectEx() and overlapped io, so the data is sent after a plain connect().
+qint64 SocketPrivate::connectAndSend(const QHostAddress &address, quint16 port, const char *data, qint64 size)
+{
+    if(!connectWithTimeout(address, port)) {
+        return -1;
+    }
+    return send(data, size, true);
+}
+
 bool SocketPrivate::close()
 {
     if(fd > 0)
     {
         ::closesocket(fd);
         EventLoopCoroutine::get()->triggerIoWatchers(fd);
+        readWatcher.reset();
+        writeWatcher.reset();
         fd = -1;
     }
     state = Socket::UnconnectedState;
@@ -801,7 +817,6 @@ qint64 SocketPrivate::recv(char *data, qint64 size, bool all)
     if(!isValid()) {
         return -1;
     }
-    ScopedIoWatcher watcher(EventLoopCoroutine::Read, fd);
     qint64 total = 0;
     while(total < size)
     {
@@ -860,7 +875,7 @@ qint64 SocketPrivate::recv(char *data, qint64 size, bool all)
                 }
             }
         }
-        watcher.start();
+        readWatcher.wait(fd);
     }
     return total;
 }
@@ -870,7 +885,6 @@ qint64 SocketPrivate::send(const char *data, qint64 size, bool all)
     if(!isValid()) {
         return -1;
     }
-    ScopedIoWatcher watcher(EventLoopCoroutine::Write, fd);
     qint64 ret = 0;
     qint64 bytesToSend = size;
     while(bytesToSend > 0)
@@ -971,12 +985,98 @@ qint64 SocketPrivate::send(const char *data, qint64 size, bool all)
             }
         }
         bytesToSend = qMin<qint64>(49152, size - ret);
-        watcher.start();
+        writeWatcher.wait(fd);
     }
     return ret;
 }
 
 
+// Windows keeps the portable path, and the buffers are sent one by one by send().
+qint64 SocketPrivate::sendv(const QList<QByteArray> &data)
+{
+    qint64 sent = 0;
+    for(const QByteArray &buf: data) {
+        if(buf.isEmpty()) {
+            continue;
+        }
+        qint64 bytes = send(buf.constData(), buf.size(), true);
+        if(bytes > 0) {
+            sent += bytes;
+        }
+        if(bytes != buf.size()) {
+            break;
+        }
+    }
+    return sent;
+}
+
+qint64 SocketPrivate::recvv(QList<QByteArray> &buffers)
+{
+    for(int i = 0; i < buffers.size(); ++i) {
+        QByteArray &buf = buffers[i];
+        if(!buf.isEmpty()) {
+            return recv(buf.data(), buf.size(), false);
+        }
+    }
+    return 0;
+}
+
+// TransmitFile() needs overlapped io to avoid blocking the event loop, so the file is read and sent in chunks.
+qint64 SocketPrivate::sendfile(int fileDescriptor, qint64 offset, qint64 length)
+{
+    if(!isValid()) {
+        return -1;
+    }
+    QFile file;
+    if(!file.open(fileDescriptor, QIODevice::ReadOnly, QFileDevice::DontCloseHandle) || !file.seek(offset)) {
+        return -1;
+    }
+    if(length < 0) {
+        length = qMax<qint64>(file.size() - offset, 0);
+    }
+    qint64 sent = 0;
+    QByteArray buf(64 * 1024, Qt::Uninitialized);
+    while(sent < length) {
+        qint64 r = file.read(buf.data(), qMin<qint64>(length - sent, buf.size()));
+        if(r <= 0) {
+            break;
+        }
+        qint64 w = send(buf.constData(), r, true);
+        if(w > 0) {
+            sent += w;
+        }
+        if(w != r) {
+            break;
+        }
+    }
+    return sent;
+}
+
+qint64 SocketPrivate::splice(SocketPrivate *source, qint64 length)
+{
+    if(!isValid() || !source->isValid()) {
+        return -1;
+    }
+    const qint64 ChunkSize = 64 * 1024;
+    qint64 moved = 0;
+    QByteArray buf(ChunkSize, Qt::Uninitialized);
+    while(length < 0 || moved < length) {
+        qint64 chunk = length < 0 ? ChunkSize : qMin(ChunkSize, length - moved);
+        qint64 r = source->recv(buf.data(), chunk, false);
+        if(r <= 0) {
+            break;
+        }
+        qint64 w = send(buf.constData(), r, true);
+        if(w > 0) {
+            moved += w;
+        }
+        if(w != r) {
+            break;
+        }
+    }
+    return moved;
+}
+
 qint64 SocketPrivate::recvfrom(char *data, qint64 size, QHostAddress *addr, quint16 *port)
 {
     if(!isValid()) {
@@ -1002,7 +1102,6 @@ qint64 SocketPrivate::recvfrom(char *data, qint64 size, QHostAddress *addr, quin
     DWORD bytesRead = 0;
     qint64 ret;
 
-    ScopedIoWatcher watcher(EventLoopCoroutine::Read, fd);
 
     while(true) {
         if(!isValid()){
@@ -1085,7 +1184,7 @@ qint64 SocketPrivate::recvfrom(char *data, qint64 size, QHostAddress *addr, quin
 #endif
             return ret;
         }
-        watcher.start();
+        readWatcher.wait(fd);
     }
 }
 
@@ -1106,7 +1205,6 @@ qint64 SocketPrivate::sendto(const char *data, qint64 size, const QHostAddress &
         // do it!
     }
 
-    ScopedIoWatcher watcher(EventLoopCoroutine::Write, fd);
     qint64 ret = 0;
     qint64 bytesToSend = size;
 
@@ -1186,7 +1284,7 @@ qint64 SocketPrivate::sendto(const char *data, qint64 size, const QHostAddress &
                 return ret;
             }
         }
-        watcher.start();
+        writeWatcher.wait(fd);
     } while(bytesToSend > 0);
 
 
@@ -1200,6 +1298,39 @@ qint64 SocketPrivate::sendto(const char *data, qint64 size, const QHostAddress &
     return ret;
 }
 
+// Windows has no recvmmsg(), so recvmany() receives one datagram per call.
+int SocketPrivate::recvmany(DatagramBatch *batch)
+{
+    DatagramBatchPrivate *b = batch->d_ptr;
+    b->entries.clear();
+    b->used = 0;
+    DatagramBatchPrivate::Entry entry;
+    entry.offset = 0;
+    entry.port = 0;
+    entry.truncated = false;
+    qint64 bytes = recvfrom(b->arena.data(), b->datagramSize, &entry.addr, &entry.port);
+    if(bytes < 0) {
+        return -1;
+    }
+    entry.length = static_cast<int>(bytes);
+    b->entries.append(entry);
+    b->used = b->datagramSize;
+    return 1;
+}
+
+int SocketPrivate::sendmany(const DatagramBatch *batch)
+{
+    const DatagramBatchPrivate *b = batch->d_ptr;
+    int sent = 0;
+    for(const DatagramBatchPrivate::Entry &entry: b->entries) {
+        if(sendto(b->arena.constData() + entry.offset, entry.length, entry.addr, entry.port) < 0) {
+            return sent > 0 ? sent : -1;
+        }
+        ++sent;
+    }
+    return sent;
+}
+
 QVariant SocketPrivate::option(Socket::SocketOption option) const
 {
     if (!isValid())
@@ -1211,6 +1342,11 @@ QVariant SocketPrivate::option(Socket::SocketOption option) const
         return QVariant(-1); // TODO return true if nonblocking is implemented.
     case Socket::TypeOfServiceOption:
     case Socket::MaxStreamsSocketOption:
+    case Socket::ReusePortOption:
+    case Socket::UdpGsoOption:
+    case Socket::UdpGroOption:
+    case Socket::TcpFastOpenOption:
+    case Socket::DeferAcceptOption:
         return -1;
     default:
         break;
@@ -1247,6 +1383,11 @@ bool SocketPrivate::setOption(Socket::SocketOption option, const QVariant &value
         return false;
     case Socket::TypeOfServiceOption:
     case Socket::MaxStreamsSocketOption:
+    case Socket::ReusePortOption:         // windows has no SO_REUSEPORT
+    case Socket::UdpGsoOption:
+    case Socket::UdpGroOption:
+    case Socket::TcpFastOpenOption:
+    case Socket::DeferAcceptOption:
         return false;
 
     default:
@@ -1283,7 +1424,6 @@ Socket *SocketPrivate::accept()
     if(state != Socket::ListeningState || type != Socket::TcpSocket)
         return 0;
 
-    ScopedIoWatcher watcher(EventLoopCoroutine::Read, fd);
     while(true) {
         int acceptedDescriptor = WSAAccept(fd, 0,0,0,0);
         if (acceptedDescriptor == -1) {
@@ -1324,9 +1464,33 @@ Socket *SocketPrivate::accept()
             Socket *conn = new Socket(acceptedDescriptor);
             return conn;
         }
-        watcher.start();
+        readWatcher.wait(fd);
     }
 }
 
 
+
+// take the first connection with accept(), then drain the backlog without waiting.
+QList<Socket*> SocketPrivate::acceptMany(int maxCount)
+{
+    QList<Socket*> sockets;
+    if(maxCount <= 0) {
+        return sockets;
+    }
+    Socket *conn = accept();
+    if(!conn) {
+        return sockets;
+    }
+    sockets.append(conn);
+    while(sockets.size() < maxCount) {
+        int acceptedDescriptor = WSAAccept(fd, 0,0,0,0);
+        if (acceptedDescriptor == -1) {
+            // errors are reported by next accept().
+            break;
+        }
+        sockets.append(new Socket(acceptedDescriptor));
+    }
+    return sockets;
+}
+
 QTNETWORKNG_NAMESPACE_END
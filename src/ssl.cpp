@@ -1,9 +1,18 @@
 ﻿#include <QtCore/qfile.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qcache.h>
 #include "../include/locks.h"
 #include "../include/ssl.h"
 #include "../include/socket.h"
 #include "../include/socket_utils.h"
 #include "../include/crypto_p.h"
+#ifdef Q_OS_WIN
+#include <winsock2.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <errno.h>
+#endif
 
 QTNETWORKNG_NAMESPACE_BEGIN
 
@@ -190,10 +199,12 @@ class SslConfigurationPrivate: public QSharedData
 {
 public:
     SslConfigurationPrivate();
-    SslConfigurationPrivate(const SslConfigurationPrivate &) = default;
+    SslConfigurationPrivate(const SslConfigurationPrivate &other);
     bool isNull() const;
     bool operator==(const SslConfigurationPrivate &other) const;
     static QSharedPointer<openssl::SSL_CTX> makeContext(const SslConfiguration &config, bool asServer);
+    static QSharedPointer<openssl::SSL_CTX> sharedContext(const SslConfiguration &config, bool asServer);
+    void clearContexts();
 
     QList<Certificate> caCertificates;
     Certificate localCertificate;
@@ -203,6 +214,12 @@ public:
     int peerVerifyDepth;
     QString peerVerifyName;
     QList<SslCipher> ciphers;
+    bool kernelTlsEnabled;
+
+    // SSL_CTX is expensive to create, it is shared by all handshakes of the same configuration.
+    mutable QMutex contextMutex;
+    mutable QSharedPointer<openssl::SSL_CTX> clientContext;
+    mutable QSharedPointer<openssl::SSL_CTX> serverContext;
 };
 
 bool SslConfigurationPrivate::operator==(const SslConfigurationPrivate &other) const
@@ -214,7 +231,8 @@ bool SslConfigurationPrivate::operator==(const SslConfigurationPrivate &other) c
             peerVerifyMode == other.peerVerifyMode &&
             peerVerifyDepth == other.peerVerifyDepth &&
             peerVerifyName == other.peerVerifyName &&
-            ciphers == other.ciphers;
+            ciphers == other.ciphers &&
+            kernelTlsEnabled == other.kernelTlsEnabled;
 }
 
 bool SslConfigurationPrivate::isNull() const
@@ -226,12 +244,40 @@ bool SslConfigurationPrivate::isNull() const
             peerVerifyMode == Ssl::AutoVerifyPeer &&
             peerVerifyDepth == 0 &&
             peerVerifyName.isEmpty() &&
-            ciphers.isEmpty();
+            ciphers.isEmpty() &&
+            !kernelTlsEnabled;
 }
 
 SslConfigurationPrivate::SslConfigurationPrivate()
+    :peerVerifyMode(Ssl::AutoVerifyPeer), peerVerifyDepth(0), kernelTlsEnabled(false)
+{
+}
+
+SslConfigurationPrivate::SslConfigurationPrivate(const SslConfigurationPrivate &other)
+    :QSharedData(other), caCertificates(other.caCertificates), localCertificate(other.localCertificate),
+      privateKey(other.privateKey), allowedNextProtocols(other.allowedNextProtocols),
+      peerVerifyMode(other.peerVerifyMode), peerVerifyDepth(other.peerVerifyDepth),
+      peerVerifyName(other.peerVerifyName), ciphers(other.ciphers), kernelTlsEnabled(other.kernelTlsEnabled)
 {
+    // the copy is going to be modified, do not share contexts.
+}
+
+void SslConfigurationPrivate::clearContexts()
+{
+    QMutexLocker locker(&contextMutex);
+    clientContext.clear();
+    serverContext.clear();
+}
 
+QSharedPointer<openssl::SSL_CTX> SslConfigurationPrivate::sharedContext(const SslConfiguration &config, bool asServer)
+{
+    const SslConfigurationPrivate *d = config.d.constData();
+    QMutexLocker locker(&d->contextMutex);
+    QSharedPointer<openssl::SSL_CTX> &ctx = asServer ? d->serverContext : d->clientContext;
+    if(ctx.isNull()) {
+        ctx = makeContext(config, asServer);
+    }
+    return ctx;
 }
 
 QSharedPointer<openssl::SSL_CTX> SslConfigurationPrivate::makeContext(const SslConfiguration &config, bool asServer)
@@ -239,7 +285,8 @@ QSharedPointer<openssl::SSL_CTX> SslConfigurationPrivate::makeContext(const SslC
     QSharedPointer<openssl::SSL_CTX> ctx;
     const openssl::SSL_METHOD *method = NULL;
     if(asServer) {
-        method = openssl::q_TLSv1_server_method();
+        // accept every protocol version the clients may offer.
+        method = openssl::q_SSLv23_server_method();
     } else {
         method = openssl::q_TLSv1_2_client_method();
     }
@@ -264,12 +311,29 @@ QSharedPointer<openssl::SSL_CTX> SslConfigurationPrivate::makeContext(const SslC
             qDebug() << "can not set ssl certificate.";
         }
     }
+    if(asServer) {
+        // the context is shared by all accepted sockets, so is the session cache.
+        static const char sessionIdContext[] = "qtnetworkng";
+        openssl::q_SSL_CTX_set_session_cache_mode(ctx.data(), SSL_SESS_CACHE_SERVER);
+        openssl::q_SSL_CTX_set_session_id_context(ctx.data(), reinterpret_cast<const unsigned char*>(sessionIdContext),
+                                                  sizeof(sessionIdContext) - 1);
+    }
     return ctx;
 }
 
 
+struct DefaultSslConfiguration
+{
+    DefaultSslConfiguration()
+        :d(new SslConfigurationPrivate()) {}
+    QSharedDataPointer<SslConfigurationPrivate> d;
+};
+
+Q_GLOBAL_STATIC(DefaultSslConfiguration, defaultSslConfiguration)
+
+// all default configurations share one private data, and thus the SSL_CTX.
 SslConfiguration::SslConfiguration()
-    :d(new SslConfigurationPrivate())
+    :d(defaultSslConfiguration()->d)
 {
 }
 
@@ -349,39 +413,57 @@ PrivateKey SslConfiguration::privateKey() const
     return d->privateKey;
 }
 
+bool SslConfiguration::isKernelTlsEnabled() const
+{
+    return d->kernelTlsEnabled;
+}
+
 void SslConfiguration::addCaCertificate(const Certificate &certificate)
 {
     d->caCertificates.append(certificate);
+    d->clearContexts();
 }
 
 void SslConfiguration::addCaCertificates(const QList<Certificate> &certificates)
 {
     d->caCertificates.append(certificates);
+    d->clearContexts();
 }
 
 void SslConfiguration::setAllowedNextProtocols(const QList<QByteArray> &protocols)
 {
     d->allowedNextProtocols = protocols;
+    d->clearContexts();
+}
+
+// kTLS is set per connection, the SSL_CTX is not changed.
+void SslConfiguration::setKernelTlsEnabled(bool enabled)
+{
+    d->kernelTlsEnabled = enabled;
 }
 
 void SslConfiguration::setPeerVerifyDepth(int depth)
 {
     d->peerVerifyDepth = depth;
+    d->clearContexts();
 }
 
 void SslConfiguration::setPeerVerifyMode(Ssl::PeerVerifyMode mode)
 {
     d->peerVerifyMode = mode;
+    d->clearContexts();
 }
 
 void SslConfiguration::setPeerVerifyName(const QString &hostName)
 {
     d->peerVerifyName = hostName;
+    d->clearContexts();
 }
 
 void SslConfiguration::setLocalCertificate(const Certificate &certificate)
 {
     d->localCertificate = certificate;
+    d->clearContexts();
 }
 
 bool SslConfiguration::setLocalCertificate(const QString &path, Ssl::EncodingFormat format)
@@ -402,6 +484,7 @@ bool SslConfiguration::setLocalCertificate(const QString &path, Ssl::EncodingFor
 void SslConfiguration::setPrivateKey(const PrivateKey &key)
 {
     d->privateKey = key;
+    d->clearContexts();
 }
 
 QList<SslCipher> SslConfiguration::supportedCiphers()
@@ -635,10 +718,19 @@ public:
     ~SslConnection();
     bool handshake(bool asServer, const QString &verificationPeerName);
     bool _handshake();
+    bool setupBio();
     qint64 recv(char *data, qint64 size, bool all);
     qint64 send(const char *data, qint64 size, bool all);
+    qint64 sendv(const QList<QByteArray> &data);
+    qint64 recvv(QList<QByteArray> &buffers);
     bool pumpOutgoing();
     bool pumpIncoming();
+    bool waitForRead();
+    bool waitForWrite();
+    static openssl::BIO_METHOD *socketBioMethod();
+    static int socketBioRead(openssl::BIO *bio, char *data, int size);
+    static int socketBioWrite(openssl::BIO *bio, const char *data, int size);
+    static long socketBioCtrl(openssl::BIO *bio, int cmd, long larg, void *parg);
     Certificate localCertificate() const;
     QList<Certificate> localCertificateChain() const;
     Certificate peerCertificate() const;
@@ -647,6 +739,11 @@ public:
     SslCipher cipher() const;
     SslSocket::SslMode mode() const;
     Ssl::SslProtocol sslProtocol() const;
+    bool isSessionResumed() const;
+    bool setupKernelTls();
+    QString currentSessionKey() const;
+    void restoreSession();
+    void saveSession(bool ok);
 
     QSharedPointer<Socket> rawSocket;
     bool asServer;
@@ -655,12 +752,22 @@ public:
     QSharedPointer<openssl::SSL> ssl;
     QString verificationPeerName;
     QList<SslError> errors;
+    QSharedPointer<SslSessionCache> sessionCache;
+    QString sessionKey;
+    // the ciphertext goes between the socket and openssl directly if the socket BIO is available.
+    bool directIo;
+    PersistentIoWatcher readWatcher;
+    PersistentIoWatcher writeWatcher;
+    // the kernel encrypts and decrypts records after handshaking.
+    bool kernelTlsSend;
+    bool kernelTlsRecv;
 };
 
 
 template<typename Socket>
 SslConnection<Socket>::SslConnection(const SslConfiguration &config)
-    :config(config)
+    :config(config), directIo(false), readWatcher(EventLoopCoroutine::Read), writeWatcher(EventLoopCoroutine::Write)
+    , kernelTlsSend(false), kernelTlsRecv(false)
 {
     initOpenSSL();
 }
@@ -668,6 +775,8 @@ SslConnection<Socket>::SslConnection(const SslConfiguration &config)
 
 template<typename Socket>
 SslConnection<Socket>::SslConnection()
+    :directIo(false), readWatcher(EventLoopCoroutine::Read), writeWatcher(EventLoopCoroutine::Write)
+    , kernelTlsSend(false), kernelTlsRecv(false)
 {
     initOpenSSL();
 }
@@ -685,28 +794,273 @@ bool SslConnection<Socket>::handshake(bool asServer, const QString &verification
     this->verificationPeerName = verificationPeerName;
     // TODO set verify name.
 
+    ctx = SslConfigurationPrivate::sharedContext(config, asServer);
+    if(ctx.isNull()) {
+        return false;
+    }
+    ssl.reset(openssl::q_SSL_new(ctx.data()), openssl::q_SSL_free);
+    if(ssl.isNull()) {
+        return false;
+    }
+    if(!setupBio()) {
+        ssl.clear();
+        return false;
+    }
+    restoreSession();
+    bool ok = _handshake();
+    saveSession(ok);
+    if(ok && config.isKernelTlsEnabled()) {
+        kernelTlsSend = openssl::q_BIO_get_ktls_send(openssl::q_SSL_get_wbio(ssl.data())) > 0;
+        kernelTlsRecv = openssl::q_BIO_get_ktls_recv(openssl::q_SSL_get_rbio(ssl.data())) > 0;
+    }
+    return ok;
+}
+
+
+template<typename Socket>
+bool SslConnection<Socket>::setupKernelTls()
+{
+#ifdef Q_OS_LINUX
+    // openssl installs the keys by setsockopt(SOL_TLS) itself, but only for its socket BIO.
+    // if the kernel or the cipher does not support kTLS, it keeps encrypting in user space.
+    // SSL_OP_ENABLE_KTLS is introduced in openssl 3.0, and SSL_set_options() takes uint64_t since then.
+    if(openssl::q_OpenSSL_version_num() < 0x30000000UL) {
+        return false;
+    }
+    openssl::BIO *bio = openssl::q_BIO_new_socket(static_cast<int>(rawSocket->fileno()), BIO_NOCLOSE);
+    if(!bio) {
+        return false;
+    }
+    openssl::q_SSL_set_bio(ssl.data(), bio, bio);
+    openssl::q_SSL_set_options(ssl.data(), SSL_OP_ENABLE_KTLS);
+    directIo = true;
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+template<typename Socket>
+bool SslConnection<Socket>::setupBio()
+{
+    if(config.isKernelTlsEnabled() && setupKernelTls()) {
+        return true;
+    }
+
+    openssl::BIO_METHOD *method = socketBioMethod();
+    if(method) {
+        openssl::BIO *bio = openssl::q_BIO_new(method);
+        if(!bio) {
+            return false;
+        }
+        openssl::q_BIO_set_data(bio, this);
+        openssl::q_BIO_set_init(bio, 1);
+        // the ssl object owns one reference of bio, which is used for both reading and writing.
+        openssl::q_SSL_set_bio(ssl.data(), bio, bio);
+        // read as many records as the socket buffer has, instead of the record header first.
+        openssl::q_SSL_set_read_ahead(ssl.data(), 1);
+        directIo = true;
+        return true;
+    }
+
+    // the openssl before 1.1.0 can not create BIO method, fallback to memory BIO.
     openssl::BIO *incoming = openssl::q_BIO_new(openssl::q_BIO_s_mem());
     if(!incoming) {
         return false;
     }
     openssl::BIO *outgoing = openssl::q_BIO_new(openssl::q_BIO_s_mem());
     if(!outgoing) {
+        openssl::q_BIO_free(incoming);
         return false;
     }
+    // do not free incoming & outgoing
+    openssl::q_SSL_set_bio(ssl.data(), incoming, outgoing);
+    directIo = false;
+    return true;
+}
+
 
-    ctx = SslConfigurationPrivate::makeContext(config, asServer);
-    if(!ctx.isNull()) {
-        ssl.reset(openssl::q_SSL_new(ctx.data()), openssl::q_SSL_free);
-        if(!ssl.isNull()) {
-            // do not free incoming & outgoing
-            openssl::q_SSL_set_bio(ssl.data(), incoming, outgoing);
-            return _handshake();
+template<typename Socket>
+openssl::BIO_METHOD *SslConnection<Socket>::socketBioMethod()
+{
+    // created once and never freed, as openssl does for its builtin methods.
+    static openssl::BIO_METHOD *method = [] {
+        // a type index of our own, so it does not collide with the custom BIOs of other libraries.
+        int index = openssl::has_BIO_get_new_index() ? openssl::q_BIO_get_new_index() : -1;
+        if(index < 0) {
+            index = 0x80;
+        }
+        openssl::BIO_METHOD *method = openssl::q_BIO_meth_new(BIO_TYPE_SOURCE_SINK | index, "qtng socket");
+        if(method) {
+            openssl::q_BIO_meth_set_read(method, socketBioRead);
+            openssl::q_BIO_meth_set_write(method, socketBioWrite);
+            openssl::q_BIO_meth_set_ctrl(method, socketBioCtrl);
         }
+        return method;
+    }();
+    return method;
+}
+
+
+// the BIO never blocks. it sets retry flags instead, so the coroutine is switched out
+// by waitForRead() and waitForWrite() after openssl returned.
+template<typename Socket>
+int SslConnection<Socket>::socketBioRead(openssl::BIO *bio, char *data, int size)
+{
+    SslConnection<Socket> *connection = static_cast<SslConnection<Socket>*>(openssl::q_BIO_get_data(bio));
+    openssl::q_BIO_clear_retry_flags(bio);
+    if(!connection->rawSocket->isValid()) {
+        return -1;
+    }
+    int fd = static_cast<int>(connection->rawSocket->fileno());
+#ifdef Q_OS_WIN
+    int result = ::recv(fd, data, size, 0);
+    if(result < 0 && WSAGetLastError() == WSAEWOULDBLOCK) {
+        openssl::q_BIO_set_retry_read(bio);
     }
+#else
+    ssize_t result;
+    do {
+        result = ::recv(fd, data, static_cast<size_t>(size), 0);
+    } while(result < 0 && errno == EINTR);
+    if(result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        openssl::q_BIO_set_retry_read(bio);
+    }
+#endif
+    return static_cast<int>(result);
+}
 
-    openssl::q_BIO_free(incoming);
-    openssl::q_BIO_free(outgoing);
-    return false;
+
+template<typename Socket>
+int SslConnection<Socket>::socketBioWrite(openssl::BIO *bio, const char *data, int size)
+{
+    SslConnection<Socket> *connection = static_cast<SslConnection<Socket>*>(openssl::q_BIO_get_data(bio));
+    openssl::q_BIO_clear_retry_flags(bio);
+    if(!connection->rawSocket->isValid()) {
+        return -1;
+    }
+    int fd = static_cast<int>(connection->rawSocket->fileno());
+#ifdef Q_OS_WIN
+    int result = ::send(fd, data, size, 0);
+    if(result < 0 && WSAGetLastError() == WSAEWOULDBLOCK) {
+        openssl::q_BIO_set_retry_write(bio);
+    }
+#else
+    ssize_t result;
+    do {
+        result = ::send(fd, data, static_cast<size_t>(size), 0);
+    } while(result < 0 && errno == EINTR);
+    if(result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        openssl::q_BIO_set_retry_write(bio);
+    }
+#endif
+    return static_cast<int>(result);
+}
+
+
+template<typename Socket>
+long SslConnection<Socket>::socketBioCtrl(openssl::BIO *bio, int cmd, long larg, void *parg)
+{
+    Q_UNUSED(bio);
+    Q_UNUSED(larg);
+    Q_UNUSED(parg);
+    // nothing is buffered in the BIO, flushing always succeeds.
+    return cmd == BIO_CTRL_FLUSH ? 1 : 0;
+}
+
+
+template<typename Socket>
+bool SslConnection<Socket>::waitForRead()
+{
+    if(!directIo) {
+        return pumpOutgoing() && pumpIncoming();
+    }
+    readWatcher.wait(rawSocket->fileno());
+    return rawSocket->isValid();
+}
+
+
+template<typename Socket>
+bool SslConnection<Socket>::waitForWrite()
+{
+    if(!directIo) {
+        return pumpOutgoing();
+    }
+    writeWatcher.wait(rawSocket->fileno());
+    return rawSocket->isValid();
+}
+
+
+template<typename Socket>
+QString SslConnection<Socket>::currentSessionKey() const
+{
+    if(!sessionKey.isEmpty()) {
+        return sessionKey;
+    }
+    const QString &host = verificationPeerName.isEmpty() ? rawSocket->peerAddress().toString() : verificationPeerName;
+    return host + QLatin1Char(':') + QString::number(rawSocket->peerPort());
+}
+
+
+template<typename Socket>
+void SslConnection<Socket>::restoreSession()
+{
+    if(asServer || sessionCache.isNull()) {
+        return;
+    }
+    const QByteArray &der = sessionCache->session(currentSessionKey());
+    if(der.isEmpty()) {
+        return;
+    }
+    const unsigned char *p = reinterpret_cast<const unsigned char*>(der.constData());
+    openssl::SSL_SESSION *session = openssl::q_d2i_SSL_SESSION(NULL, &p, der.size());
+    if(session) {
+        // SSL_set_session() takes its own reference.
+        openssl::q_SSL_set_session(ssl.data(), session);
+        openssl::q_SSL_SESSION_free(session);
+    }
+}
+
+
+template<typename Socket>
+void SslConnection<Socket>::saveSession(bool ok)
+{
+    if(asServer || sessionCache.isNull()) {
+        return;
+    }
+    const QString &key = currentSessionKey();
+    if(!ok) {
+        // the server may have dropped the session, do a full handshake next time.
+        sessionCache->remove(key);
+        return;
+    }
+    if(isSessionResumed()) {
+        return;
+    }
+    openssl::SSL_SESSION *session = openssl::q_SSL_get1_session(ssl.data());
+    if(!session) {
+        return;
+    }
+    int len = openssl::q_i2d_SSL_SESSION(session, NULL);
+    if(len > 0) {
+        QByteArray der(len, Qt::Uninitialized);
+        unsigned char *p = reinterpret_cast<unsigned char*>(der.data());
+        if(openssl::q_i2d_SSL_SESSION(session, &p) == len) {
+            sessionCache->setSession(key, der);
+        }
+    }
+    openssl::q_SSL_SESSION_free(session);
+}
+
+
+template<typename Socket>
+bool SslConnection<Socket>::isSessionResumed() const
+{
+    if(ssl.isNull()) {
+        return false;
+    }
+    return openssl::q_SSL_session_reused(ssl.data()) == 1;
 }
 
 
@@ -719,11 +1073,10 @@ bool SslConnection<Socket>::_handshake()
             QByteArray buf;
             switch(openssl::q_SSL_get_error(ssl.data(), result)) {
             case SSL_ERROR_WANT_READ:
-                if(!pumpOutgoing()) return false;
-                if(!pumpIncoming()) return false;
+                if(!waitForRead()) return false;
                 break;
             case SSL_ERROR_WANT_WRITE:
-                if(!pumpOutgoing()) return false;
+                if(!waitForWrite()) return false;
                 break;
             case SSL_ERROR_ZERO_RETURN:
             case SSL_ERROR_WANT_CONNECT:
@@ -736,7 +1089,7 @@ bool SslConnection<Socket>::_handshake()
                 return false;
             }
         } else {
-            return true;
+            return directIo || pumpOutgoing();
         }
     }
 }
@@ -791,15 +1144,12 @@ qint64 SslConnection<Socket>::recv(char *data, qint64 size, bool all)
         if(result < 0) {
             switch(openssl::q_SSL_get_error(ssl.data(), result)) {
             case SSL_ERROR_WANT_READ:
-                if(!pumpOutgoing()) {
-                    return total == 0 ? -1 : total;
-                }
-                if(!pumpIncoming()) {
+                if(!waitForRead()) {
                     return total == 0 ? -1 : total;
                 }
                 break;
             case SSL_ERROR_WANT_WRITE:
-                if(!pumpOutgoing()) {
+                if(!waitForWrite()) {
                     return total == 0 ? -1 : total;
                 }
                 break;
@@ -829,21 +1179,22 @@ qint64 SslConnection<Socket>::recv(char *data, qint64 size, bool all)
 template<typename Socket>
 qint64 SslConnection<Socket>::send(const char *data, qint64 size, bool all)
 {
+    if(kernelTlsSend) {
+        // the kernel makes application data records from plain writes.
+        return all ? rawSocket->sendall(data, size) : rawSocket->send(data, size);
+    }
     qint64 total = 0;
     while(true) {
         int result = openssl::q_SSL_write(ssl.data(), data + total, size - total);
         if(result < 0) {
             switch(openssl::q_SSL_get_error(ssl.data(), result)) {
             case SSL_ERROR_WANT_READ:
-                if(!pumpOutgoing()) {
-                    return total == 0 ? -1 : total;
-                }
-                if(!pumpIncoming()) {
+                if(!waitForRead()) {
                     return total == 0 ? -1 : total;
                 }
                 break;
             case SSL_ERROR_WANT_WRITE:
-                if(!pumpOutgoing()) {
+                if(!waitForWrite()) {
                     return total == 0 ? -1 : total;
                 }
                 break;
@@ -859,6 +1210,10 @@ qint64 SslConnection<Socket>::send(const char *data, qint64 size, bool all)
             }
         } else {
             total += result;
+            // the memory BIO holds the records until they are pumped out.
+            if(!directIo && !pumpOutgoing()) {
+                return total;
+            }
             if(total > size) {
                 qDebug() << "send too many data.";
                 return size;
@@ -875,6 +1230,68 @@ qint64 SslConnection<Socket>::send(const char *data, qint64 size, bool all)
     }
 }
 
+// openssl has no SSL_writev(), so small buffers are gathered into one record instead of one record for each.
+template<typename Socket>
+qint64 SslConnection<Socket>::sendv(const QList<QByteArray> &data)
+{
+    if(kernelTlsSend) {
+        return rawSocket->sendv(data);
+    }
+    const int MaxRecordSize = 16 * 1024;
+    qint64 total = 0;
+    QByteArray record;
+    for(int i = 0; i <= data.size(); ++i) {
+        bool last = i == data.size();
+        const QByteArray &buf = last ? QByteArray() : data.at(i);
+        if(!record.isEmpty() && (last || record.size() + buf.size() > MaxRecordSize)) {
+            qint64 sent = send(record.constData(), record.size(), true);
+            if(sent != record.size()) {
+                return total + qMax<qint64>(sent, 0);
+            }
+            total += sent;
+            record.clear();
+        }
+        if(buf.size() >= MaxRecordSize) {
+            qint64 sent = send(buf.constData(), buf.size(), true);
+            if(sent != buf.size()) {
+                return total + qMax<qint64>(sent, 0);
+            }
+            total += sent;
+        } else if(!buf.isEmpty()) {
+            if(record.isEmpty()) {
+                record.reserve(MaxRecordSize);
+            }
+            record.append(buf);
+        }
+    }
+    return total;
+}
+
+// only the first read may wait, the next buffers take the plaintext which openssl has decrypted already.
+template<typename Socket>
+qint64 SslConnection<Socket>::recvv(QList<QByteArray> &buffers)
+{
+    qint64 total = 0;
+    for(int i = 0; i < buffers.size(); ++i) {
+        QByteArray &buf = buffers[i];
+        if(buf.isEmpty()) {
+            continue;
+        }
+        if(total > 0 && openssl::q_SSL_pending(ssl.data()) <= 0) {
+            break;
+        }
+        qint64 bytes = recv(buf.data(), buf.size(), false);
+        if(bytes <= 0) {
+            return total == 0 ? bytes : total;
+        }
+        total += bytes;
+        if(bytes < buf.size()) {
+            break;
+        }
+    }
+    return total;
+}
+
 template<typename Socket>
 Certificate SslConnection<Socket>::localCertificate() const
 {
@@ -1000,6 +1417,93 @@ Ssl::SslProtocol SslConnection<Socket>::sslProtocol() const
     return Ssl::UnknownProtocol;
 }
 
+class SslSessionCachePrivate
+{
+public:
+    SslSessionCachePrivate(int capacity)
+        :sessions(capacity) {}
+    mutable QMutex mutex;
+    QCache<QString, QByteArray> sessions;
+};
+
+
+SslSessionCache::SslSessionCache(int capacity)
+    :d_ptr(new SslSessionCachePrivate(capacity))
+{
+}
+
+
+SslSessionCache::~SslSessionCache()
+{
+    delete d_ptr;
+}
+
+
+QByteArray SslSessionCache::session(const QString &key) const
+{
+    Q_D(const SslSessionCache);
+    QMutexLocker locker(&d->mutex);
+    // QCache::object() is not const because it updates the lru list.
+    QByteArray *session = const_cast<SslSessionCachePrivate*>(d)->sessions.object(key);
+    if(session) {
+        return *session;
+    }
+    return QByteArray();
+}
+
+
+void SslSessionCache::setSession(const QString &key, const QByteArray &session)
+{
+    Q_D(SslSessionCache);
+    QMutexLocker locker(&d->mutex);
+    if(session.isEmpty()) {
+        d->sessions.remove(key);
+    } else {
+        d->sessions.insert(key, new QByteArray(session));
+    }
+}
+
+
+void SslSessionCache::remove(const QString &key)
+{
+    Q_D(SslSessionCache);
+    QMutexLocker locker(&d->mutex);
+    d->sessions.remove(key);
+}
+
+
+void SslSessionCache::clear()
+{
+    Q_D(SslSessionCache);
+    QMutexLocker locker(&d->mutex);
+    d->sessions.clear();
+}
+
+
+int SslSessionCache::size() const
+{
+    Q_D(const SslSessionCache);
+    QMutexLocker locker(&d->mutex);
+    return d->sessions.size();
+}
+
+
+int SslSessionCache::capacity() const
+{
+    Q_D(const SslSessionCache);
+    QMutexLocker locker(&d->mutex);
+    return d->sessions.maxCost();
+}
+
+
+void SslSessionCache::setCapacity(int capacity)
+{
+    Q_D(SslSessionCache);
+    QMutexLocker locker(&d->mutex);
+    d->sessions.setMaxCost(capacity);
+}
+
+
 class SslSocketPrivate: public SslConnection<Socket>
 {
 public:
@@ -1144,13 +1648,45 @@ void SslSocket::setSslConfiguration(const SslConfiguration &configuration)
     d->config = configuration;
 }
 
+void SslSocket::setSessionCache(QSharedPointer<SslSessionCache> cache, const QString &sessionKey)
+{
+    Q_D(SslSocket);
+    d->sessionCache = cache;
+    d->sessionKey = sessionKey;
+}
+
+QSharedPointer<SslSessionCache> SslSocket::sessionCache() const
+{
+    Q_D(const SslSocket);
+    return d->sessionCache;
+}
+
+bool SslSocket::isSessionResumed() const
+{
+    Q_D(const SslSocket);
+    return d->isSessionResumed();
+}
+
+bool SslSocket::isKernelTlsSendEnabled() const
+{
+    Q_D(const SslSocket);
+    return d->kernelTlsSend;
+}
+
+bool SslSocket::isKernelTlsReceiveEnabled() const
+{
+    Q_D(const SslSocket);
+    return d->kernelTlsRecv;
+}
+
 
 QSharedPointer<SslSocket> SslSocket::accept()
 {
     Q_D(SslSocket);
     Socket *rawSocket = d->rawSocket->accept();
     if(rawSocket) {
-        QSharedPointer<SslSocket> s(new SslSocket(QSharedPointer<Socket>(rawSocket)));
+        // share the configuration, and thus the SSL_CTX and its session cache.
+        QSharedPointer<SslSocket> s(new SslSocket(QSharedPointer<Socket>(rawSocket), d->config));
         if(s->d_func()->handshake(true, QString())) {
             return s;
         }
@@ -1368,6 +1904,49 @@ qint64 SslSocket::sendall(const QByteArray &data)
     return d->send(data.data(), data.size(), true);
 }
 
+qint64 SslSocket::sendv(const QList<QByteArray> &data)
+{
+    Q_D(SslSocket);
+    return d->sendv(data);
+}
+
+qint64 SslSocket::recvv(QList<QByteArray> &buffers)
+{
+    Q_D(SslSocket);
+    return d->recvv(buffers);
+}
+
+// only the kernel can encrypt the pages of file without copying them to user space.
+qint64 SslSocket::sendfile(QFile &file, qint64 offset, qint64 length)
+{
+    Q_D(SslSocket);
+    if(d->kernelTlsSend) {
+        return d->rawSocket->sendfile(file, offset, length);
+    }
+    if(!file.isOpen() || !file.seek(offset)) {
+        return -1;
+    }
+    if(length < 0) {
+        length = qMax<qint64>(file.size() - offset, 0);
+    }
+    qint64 sent = 0;
+    QByteArray buf(16 * 1024, Qt::Uninitialized);
+    while(sent < length) {
+        qint64 r = file.read(buf.data(), qMin<qint64>(length - sent, buf.size()));
+        if(r <= 0) {
+            break;
+        }
+        qint64 w = d->send(buf.constData(), r, true);
+        if(w > 0) {
+            sent += w;
+        }
+        if(w != r) {
+            break;
+        }
+    }
+    return sent;
+}
+
 
 namespace {
 
@@ -1407,6 +1986,8 @@ public:
     virtual QByteArray recvall(qint64 size) override;
     virtual qint64 send(const QByteArray &data) override;
     virtual qint64 sendall(const QByteArray &data) override;
+    virtual qint64 sendv(const QList<QByteArray> &data) override;
+    virtual qint64 recvv(QList<QByteArray> &buffers) override;
 private:
     QSharedPointer<SslSocket> s;
 };
@@ -1559,6 +2140,16 @@ qint64 SocketLikeImpl::sendall(const QByteArray &data)
     return s->sendall(data);
 }
 
+qint64 SocketLikeImpl::sendv(const QList<QByteArray> &data)
+{
+    return s->sendv(data);
+}
+
+qint64 SocketLikeImpl::recvv(QList<QByteArray> &buffers)
+{
+    return s->recvv(buffers);
+}
+
 } //anonymous namespace
 
 QSharedPointer<SocketLike> SocketLike::sslSocket(QSharedPointer<SslSocket> s)
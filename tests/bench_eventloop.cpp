@@ -0,0 +1,154 @@
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include "qtnetworkng.h"
+
+// build with CONFIG+=networkng_ev or CONFIG+=networkng_epoll to compare the event loop backends.
+
+using namespace qtng;
+
+static void benchTimers()
+{
+    const int coroutines = 1000;
+    const int rounds = 100;
+    CoroutineGroup operations;
+    QElapsedTimer timer;
+    timer.start();
+    for(int i = 0; i < coroutines; ++i) {
+        operations.spawn([] {
+            for(int j = 0; j < rounds; ++j) {
+                Coroutine::msleep(0);
+            }
+        });
+    }
+    operations.joinall();
+    qint64 elapsed = qMax<qint64>(timer.elapsed(), 1);
+    qDebug() << "timers:" << coroutines * rounds << "switches in" << elapsed << "ms," << coroutines * rounds * 1000 / elapsed << "per second.";
+}
+
+
+static void benchPingPong()
+{
+    const int pairs = 100;
+    const int rounds = 1000;
+    Socket server;
+    server.setOption(Socket::AddressReusable, true);
+    QHostAddress localhost(QHostAddress::LocalHost);
+    server.bind(localhost, 0);
+    server.listen(pairs);
+    quint16 port = server.localPort();
+
+    CoroutineGroup operations;
+    operations.spawn([&server, &operations] {
+        for(int i = 0; i < pairs; ++i) {
+            Socket *request = server.accept();
+            if(!request) {
+                return;
+            }
+            operations.spawn([request] {
+                QScopedPointer<Socket> guard(request);
+                char buf[64];
+                while(request->recvall(buf, sizeof(buf)) == sizeof(buf)) {
+                    request->sendall(buf, sizeof(buf));
+                }
+            });
+        }
+    });
+
+    QElapsedTimer timer;
+    timer.start();
+    CoroutineGroup clients;
+    for(int i = 0; i < pairs; ++i) {
+        clients.spawn([port] {
+            Socket client;
+            if(!client.connect(QHostAddress(QHostAddress::LocalHost), port)) {
+                return;
+            }
+            char buf[64] = {0};
+            for(int j = 0; j < rounds; ++j) {
+                if(client.sendall(buf, sizeof(buf)) != sizeof(buf) || client.recvall(buf, sizeof(buf)) != sizeof(buf)) {
+                    return;
+                }
+            }
+        });
+    }
+    clients.joinall();
+    qint64 elapsed = qMax<qint64>(timer.elapsed(), 1);
+    qDebug() << "ping-pong:" << pairs * rounds << "round trips in" << elapsed << "ms," << pairs * rounds * 1000 / elapsed << "per second.";
+    server.close();
+    operations.killall();
+}
+
+
+// compare sendto()/recvfrom() with sendmany()/recvmany() on loopback.
+static void benchDatagrams(bool batched)
+{
+    const int total = 200000;
+    const int batchSize = 64;
+    const int datagramSize = 1000;
+    QHostAddress localhost(QHostAddress::LocalHost);
+    Socket receiver(Socket::IPv4Protocol, Socket::UdpSocket);
+    receiver.bind(localhost, 0);
+    receiver.setOption(Socket::ReceiveBufferSizeSocketOption, 8 * 1024 * 1024);
+    Socket sender(Socket::IPv4Protocol, Socket::UdpSocket);
+    sender.bind(localhost, 0);
+    quint16 port = receiver.localPort();
+
+    CoroutineGroup operations;
+    int received = 0;
+    operations.spawn([&receiver, &received, batched] {
+        DatagramBatch batch(batchSize, datagramSize);
+        QByteArray buf(datagramSize, Qt::Uninitialized);
+        while(received < total) {
+            int count;
+            if(batched) {
+                count = receiver.recvmany(batch);
+            } else {
+                count = receiver.recvfrom(buf.data(), buf.size(), 0, 0) < 0 ? -1 : 1;
+            }
+            if(count <= 0) {
+                return;
+            }
+            received += count;
+        }
+    });
+
+    QElapsedTimer timer;
+    timer.start();
+    const QByteArray payload(datagramSize, 'x');
+    DatagramBatch batch(batchSize, datagramSize);
+    for(int i = 0; i < batchSize; ++i) {
+        batch.append(payload, localhost, port);
+    }
+    // leave time for the receiver to drain the socket buffer, because UDP drops datagrams silently.
+    for(int sent = 0; sent < total; sent += batchSize) {
+        if(batched) {
+            sender.sendmany(batch);
+        } else {
+            for(int i = 0; i < batchSize; ++i) {
+                sender.sendto(payload, localhost, port);
+            }
+        }
+        for(int j = 0; j < 10 && sent - received > 1024; ++j) {
+            Coroutine::msleep(0);
+        }
+    }
+    for(int i = 0; i < 100 && received < total; ++i) {
+        Coroutine::msleep(1);
+    }
+    operations.killall();
+    qint64 elapsed = qMax<qint64>(timer.elapsed(), 1);
+    qDebug() << (batched ? "sendmany/recvmany:" : "sendto/recvfrom:") << received << "of" << total << "datagrams in"
+             << elapsed << "ms," << received * 1000 / elapsed << "per second.";
+}
+
+
+int bench_eventloop(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+    Q_UNUSED(app);
+    benchTimers();
+    benchPingPong();
+    benchDatagrams(false);
+    benchDatagrams(true);
+    return 0;
+}
@@ -13,6 +13,21 @@ private slots:
     void testJoinall();
     void testMap();
     void testeach();
+    void testStackPool();
+    void testStackUsage();
+    void testTimers();
+    void testCallLaterThreadSafe();
+    void testLoopPool();
+    void testHandOverSocket();
+    void testReusePortServer();
+    void testAcceptMany();
+    void testVectoredIo();
+    void testSendfileAndSplice();
+    void testSocketBuffer();
+    void testDatagramBatch();
+    void testHappyEyeballs();
+    void testTcpFastOpen();
+    void testIdleConnectionRetry();
 };
 
 
@@ -100,6 +115,602 @@ void TestCoroutines::testeach()
 }
 
 
+void TestCoroutines::testStackPool()
+{
+    CoroutineStackPool::clear();
+    int highWaterMark = CoroutineStackPool::highWaterMark();
+    CoroutineStackPool::setHighWaterMark(2);
+    {
+        CoroutineGroup operations;
+        for(int i = 0; i < 4; ++i) {
+            operations.spawn([] { Coroutine::sleep(0.01); });
+        }
+        operations.joinall();
+    }
+    // finished coroutines are deleted by the event loop.
+    Coroutine::sleep(0.01);
+    QCOMPARE(CoroutineStackPool::cachedStacks(), 2);
+    QSharedPointer<Coroutine> c(Coroutine::spawn([] {}));
+    c->join();
+    c.clear();
+    QCOMPARE(CoroutineStackPool::cachedStacks(), 2);
+    CoroutineStackPool::clear();
+    QCOMPARE(CoroutineStackPool::cachedStacks(), 0);
+    CoroutineStackPool::setHighWaterMark(highWaterMark);
+}
+
+static void useStack(int bytes)
+{
+    volatile char buf[1024 * 16];
+    for(int i = 0; i < bytes && i < static_cast<int>(sizeof(buf)); ++i) {
+        buf[i] = 1;
+    }
+}
+
+void TestCoroutines::testStackUsage()
+{
+    size_t defaultStackSize = BaseCoroutine::defaultStackSize();
+    BaseCoroutine::setDefaultStackSize(1024 * 64);
+    QSharedPointer<Coroutine> c(Coroutine::spawn([] { useStack(1024 * 16); }));
+    BaseCoroutine::setDefaultStackSize(defaultStackSize);
+    c->join();
+    QCOMPARE(c->stackSize(), size_t(1024 * 64));
+#ifndef Q_OS_WIN
+    QVERIFY(c->peakStackUsage() >= size_t(1024 * 16));
+    QVERIFY(c->peakStackUsage() < size_t(1024 * 64));
+#endif
+}
+
+void TestCoroutines::testTimers()
+{
+    EventLoopCoroutine *loop = EventLoopCoroutine::get();
+    QSharedPointer<QList<int>> fired(new QList<int>());
+    QList<int> ids;
+    // 300ms and 280ms go to the second level of the timer wheel.
+    const int delays[] = {300, 0, 20, 280, 5};
+    for(int delay: delays) {
+        ids.append(loop->callLater(delay, new LambdaFunctor([fired, delay] { fired->append(delay); })));
+    }
+    loop->cancelCall(ids.at(3));
+    QSharedPointer<int> repeats(new int(0));
+    int repeatId = loop->callRepeat(10, new LambdaFunctor([repeats] { ++*repeats; }));
+    Coroutine::msleep(350);
+    loop->cancelCall(repeatId);
+    QCOMPARE(*fired, QList<int>() << 0 << 5 << 20 << 300);
+    QVERIFY(*repeats >= 10);
+    int repeated = *repeats;
+
+    // cancelling a fired timer does not touch the new ones.
+    loop->callLater(10, new LambdaFunctor([fired] { fired->append(10); }));
+    loop->cancelCall(ids.at(1));
+    Coroutine::msleep(30);
+    QCOMPARE(fired->last(), 10);
+    QCOMPARE(*repeats, repeated);
+}
+
+class CallLaterThread: public QThread
+{
+public:
+    CallLaterThread(EventLoopCoroutine *loop, std::function<void()> callback, int calls)
+        :loop(loop), callback(callback), calls(calls) {}
+    virtual void run() override
+    {
+        for(int i = 0; i < calls; ++i) {
+            loop->callLaterThreadSafe(i % 2, new LambdaFunctor(callback));
+        }
+    }
+    EventLoopCoroutine *loop;
+    std::function<void()> callback;
+    int calls;
+};
+
+void TestCoroutines::testCallLaterThreadSafe()
+{
+    const int threads = 4;
+    const int calls = 10000;
+    QSharedPointer<int> called(new int(0));
+    QSharedPointer<Event> done(new Event());
+    std::function<void()> callback = [called, done] {
+        if(++*called == threads * calls) {
+            done->set();
+        }
+    };
+    QList<QThread*> workers;
+    for(int i = 0; i < threads; ++i) {
+        QThread *worker = new CallLaterThread(EventLoopCoroutine::get(), callback, calls);
+        worker->start();
+        workers.append(worker);
+    }
+    QVERIFY(done->wait());
+    QCOMPARE(*called, threads * calls);
+    for(QThread *worker: workers) {
+        worker->wait();
+        delete worker;
+    }
+}
+
+void TestCoroutines::testLoopPool()
+{
+    const int tasks = 100;
+    LoopPool pool(4);
+    QCOMPARE(pool.size(), 4);
+    ThreadQueue<QThread*> results(0);
+    for(int i = 0; i < tasks; ++i) {
+        int index = pool.spawn([&results] {
+            Coroutine::msleep(1);
+            results.put(QThread::currentThread());
+        });
+        QCOMPARE(index, i % pool.size());
+    }
+    QSet<QThread*> threads;
+    for(int i = 0; i < tasks; ++i) {
+        QThread *thread = results.get();
+        QVERIFY(thread != QThread::currentThread());
+        threads.insert(thread);
+    }
+    QCOMPARE(threads.size(), pool.size());
+    for(int i = 0; i < pool.size(); ++i) {
+        while(pool.load(i) > 0) {
+            Coroutine::msleep(1);
+        }
+    }
+
+    pool.setPlacementPolicy(LoopPool::LeastLoaded);
+    ThreadEvent started;
+    ThreadEvent stop;
+    QVERIFY(pool.spawnOn(pool.loop(2), [&started, &stop] {
+        started.set();
+        stop.wait();
+    }));
+    QVERIFY(started.wait());
+    QCOMPARE(pool.load(2), 1);
+    for(int i = 0; i < pool.size() - 1; ++i) {
+        QVERIFY(pool.spawn([] {}) != 2);
+    }
+    stop.set();
+}
+
+
+void TestCoroutines::testHandOverSocket()
+{
+    LoopPool pool(1);
+    QHostAddress localhost(QHostAddress::LocalHost);
+    Socket sender(Socket::IPv4Protocol, Socket::UdpSocket);
+    ThreadQueue<quint16> ports(0);
+
+    // the socket waits in the pool thread, and is destroyed in this thread.
+    ThreadQueue<Socket*> sockets(0);
+    pool.spawn([&ports, &sockets, localhost] {
+        Socket *s = new Socket(Socket::IPv4Protocol, Socket::UdpSocket);
+        s->bind(localhost, 0);
+        ports.put(s->localPort());
+        s->recv(16);
+        sockets.put(s);
+    });
+    quint16 port = ports.get();
+    Coroutine::msleep(50);
+    QCOMPARE(sender.sendto(QByteArray("1"), localhost, port), qint64(1));
+    delete sockets.get();
+
+    // the next socket of the pool thread may take the same fd, its watcher must still work.
+    ThreadQueue<QByteArray> results(0);
+    pool.spawn([&ports, &results, localhost] {
+        Socket s(Socket::IPv4Protocol, Socket::UdpSocket);
+        s.bind(localhost, 0);
+        ports.put(s.localPort());
+        results.put(s.recv(16));
+    });
+    port = ports.get();
+    Coroutine::msleep(50);
+    QCOMPARE(sender.sendto(QByteArray("2"), localhost, port), qint64(1));
+    QCOMPARE(results.get(), QByteArray("2"));
+}
+
+void TestCoroutines::testReusePortServer()
+{
+    const int clients = 40;
+    LoopPool pool(4);
+    ThreadQueue<QThread*> handled(0);
+    ReusePortServer server(&pool, QHostAddress(QHostAddress::LocalHost));
+    server.setHandler([&handled] (QSharedPointer<Socket> request) {
+        request->sendall(QByteArray("x"));
+        handled.put(QThread::currentThread());
+    });
+    QVERIFY(server.start());
+    QVERIFY(server.serverPort() != 0);
+#ifdef Q_OS_LINUX
+    QCOMPARE(server.shards(), pool.size());
+#endif
+    for(int i = 0; i < clients; ++i) {
+        Socket client;
+        QVERIFY(client.connect(QHostAddress(QHostAddress::LocalHost), server.serverPort()));
+        QCOMPARE(client.recvall(1), QByteArray("x"));
+    }
+    for(int i = 0; i < clients; ++i) {
+        QVERIFY(handled.get() != QThread::currentThread());
+    }
+    server.stop();
+    QVERIFY(!server.isRunning());
+    Socket client;
+    QVERIFY(!client.connect(QHostAddress(QHostAddress::LocalHost), server.serverPort()));
+
+    // the pool may stop before the shards run, the server must still stop.
+    LoopPool stopping(2);
+    ReusePortServer early(&stopping, QHostAddress(QHostAddress::LocalHost));
+    early.setHandler([] (QSharedPointer<Socket>) {});
+    QVERIFY(early.start());
+    stopping.stop();
+    early.stop();
+    QVERIFY(!early.isRunning());
+}
+
+void TestCoroutines::testAcceptMany()
+{
+    Socket server;
+    server.setOption(Socket::AddressReusable, true);
+    QHostAddress localhost(QHostAddress::LocalHost);
+    QVERIFY(server.bind(localhost, 0));
+    QVERIFY(server.listen(16));
+    QList<QSharedPointer<Socket>> clients;
+    QSet<quint16> ports;
+    for(int i = 0; i < 5; ++i) {
+        QSharedPointer<Socket> client(new Socket());
+        QVERIFY(client->connect(localhost, server.localPort()));
+        ports.insert(client->localPort());
+        clients.append(client);
+    }
+    QList<Socket*> accepted = server.acceptMany(3);
+    QCOMPARE(accepted.size(), 3);
+    accepted.append(server.acceptMany());
+    QCOMPARE(accepted.size(), 5);
+    for(Socket *request: accepted) {
+        QVERIFY(ports.remove(request->peerPort()));
+        QCOMPARE(request->peerAddress(), localhost);
+        QCOMPARE(request->localPort(), server.localPort());
+        QCOMPARE(request->state(), Socket::ConnectedState);
+        delete request;
+    }
+}
+
+void TestCoroutines::testVectoredIo()
+{
+    Socket server;
+    server.setOption(Socket::AddressReusable, true);
+    QHostAddress localhost(QHostAddress::LocalHost);
+    QVERIFY(server.bind(localhost, 0));
+    QVERIFY(server.listen(1));
+    Socket client;
+    QVERIFY(client.connect(localhost, server.localPort()));
+    QScopedPointer<Socket> request(server.accept());
+    QVERIFY(!request.isNull());
+
+    QList<QByteArray> data;
+    data << QByteArray("GET / HTTP/1.1\r\n") << QByteArray() << QByteArray("\r\n") << QByteArray(100000, 'x');
+    QCOMPARE(client.sendv(data), qint64(16 + 2 + 100000));
+
+    QList<QByteArray> buffers;
+    buffers << QByteArray(16, '\0') << QByteArray(2, '\0');
+    QCOMPARE(request->recvv(buffers), qint64(18));
+    QCOMPARE(buffers.at(0), data.at(0));
+    QCOMPARE(buffers.at(1), data.at(2));
+    QCOMPARE(request->recvall(100000), data.at(3));
+}
+
+void TestCoroutines::testSendfileAndSplice()
+{
+    QHostAddress localhost(QHostAddress::LocalHost);
+    Socket server;
+    server.setOption(Socket::AddressReusable, true);
+    QVERIFY(server.bind(localhost, 0));
+    QVERIFY(server.listen(2));
+    Socket sender, receiver;
+    QVERIFY(sender.connect(localhost, server.localPort()));
+    QScopedPointer<Socket> relayIn(server.accept());
+    QVERIFY(receiver.connect(localhost, server.localPort()));
+    QScopedPointer<Socket> relayOut(server.accept());
+    QVERIFY(!relayIn.isNull() && !relayOut.isNull());
+
+    QByteArray content;
+    for(int i = 0; i < 300000; ++i) {
+        content.append(static_cast<char>(i * 31));
+    }
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    QCOMPARE(file.write(content), qint64(content.size()));
+
+    const qint64 offset = 1000;
+    const qint64 length = content.size() - offset;
+    CoroutineGroup operations;
+    operations.spawn([&] {
+        QCOMPARE(sender.sendfile(file, offset, length), length);
+    });
+    operations.spawn([&] {
+        QCOMPARE(relayOut->splice(*relayIn, length), length);
+    });
+    QCOMPARE(receiver.recvall(length), content.mid(offset));
+    operations.joinall();
+}
+
+void TestCoroutines::testSocketBuffer()
+{
+    Socket server;
+    server.setOption(Socket::AddressReusable, true);
+    QHostAddress localhost(QHostAddress::LocalHost);
+    QVERIFY(server.bind(localhost, 0));
+    QVERIFY(server.listen(1));
+    Socket client;
+    QVERIFY(client.connect(localhost, server.localPort()));
+    QSharedPointer<Socket> request(server.accept());
+    QVERIFY(!request.isNull());
+
+    QByteArray data;
+    for(int i = 0; i < 1000; ++i) {
+        data.append(QByteArray("line ") + QByteArray::number(i) + QByteArray(i % 37, 'x') + QByteArray("\r\n"));
+    }
+    data.append(QByteArray(20000, 'y'));
+    QCOMPARE(client.sendall(data), qint64(data.size()));
+    client.close();
+
+    SocketBuffer buf(SocketLike::rawSocket(request), 16);
+    QByteArray lines;
+    for(int i = 0; i < 1000; ++i) {
+        const QByteArray &line = buf.readLine(64);
+        QVERIFY(line.endsWith("\r\n"));
+        lines.append(line);
+    }
+    QCOMPARE(lines, data.left(lines.size()));
+    QVERIFY(buf.fill(20000));
+    QCOMPARE(buf.peek(5), QByteArray(5, 'y'));
+    buf.consume(5);
+    QCOMPARE(buf.indexOf('y'), 0);
+    QCOMPARE(buf.readAll(), QByteArray(19995, 'y'));
+    QVERIFY(buf.isEmpty());
+    QVERIFY(buf.readLine().isEmpty());
+    QVERIFY(!buf.fill(1));
+}
+
+
+void TestCoroutines::testDatagramBatch()
+{
+    QHostAddress localhost(QHostAddress::LocalHost);
+    Socket receiver(Socket::IPv4Protocol, Socket::UdpSocket);
+    QVERIFY(receiver.bind(localhost, 0));
+    receiver.setOption(Socket::UdpGroOption, true);
+    Socket sender(Socket::IPv4Protocol, Socket::UdpSocket);
+    QVERIFY(sender.bind(localhost, 0));
+    sender.setOption(Socket::UdpGsoOption, true);
+
+    DatagramBatch batch(100, 1000);
+    for(int i = 0; i < 100; ++i) {
+        QByteArray data(i == 99 ? 10 : 1000, 'a' + i % 26);
+        QVERIFY(batch.append(data, localhost, receiver.localPort()));
+    }
+    QVERIFY(!batch.append(QByteArray("x"), localhost, receiver.localPort()));
+    QCOMPARE(batch.size(), 100);
+    QCOMPARE(sender.sendmany(batch), 100);
+
+    DatagramBatch received(16, 65535);
+    QList<QByteArray> datagrams;
+    while(datagrams.size() < 100) {
+        int count = receiver.recvmany(received);
+        QVERIFY(count > 0);
+        QCOMPARE(count, received.size());
+        for(int i = 0; i < count; ++i) {
+            QCOMPARE(received.address(i), localhost);
+            QCOMPARE(received.port(i), sender.localPort());
+            QVERIFY(!received.isTruncated(i));
+            datagrams.append(received.datagram(i));
+        }
+    }
+    QCOMPARE(datagrams.size(), 100);
+    for(int i = 0; i < 100; ++i) {
+        QCOMPARE(datagrams.at(i), batch.datagram(i));
+    }
+
+    // the merged datagrams do not fit in small slots.
+    DatagramBatch small(4, 8);
+    if(receiver.option(Socket::UdpGroOption).toInt() > 0) {
+        QCOMPARE(receiver.recvmany(small), -1);
+        QCOMPARE(receiver.error(), Socket::DatagramTooLargeError);
+    }
+#ifdef Q_OS_UNIX
+    receiver.setOption(Socket::UdpGroOption, false);
+    QCOMPARE(sender.sendto(QByteArray("a datagram larger than the slot."), localhost, receiver.localPort()), qint64(32));
+    QCOMPARE(receiver.recvmany(small), 1);
+    QCOMPARE(small.length(0), 8);
+    QVERIFY(small.isTruncated(0));
+    QCOMPARE(small.datagram(0), QByteArray("a datagr"));
+#endif
+}
+
+
+void TestCoroutines::testHappyEyeballs()
+{
+    Socket server(Socket::IPv4Protocol);
+    server.setOption(Socket::AddressReusable, true);
+    QHostAddress localhost(QHostAddress::LocalHost);
+    QVERIFY(server.bind(localhost, 0));
+    QVERIFY(server.listen(8));
+    quint16 port = server.localPort();
+
+    // localhost may resolve to ::1 as well, which refuses the connection.
+    Socket client;
+    client.setConnectAttemptDelay(50);
+    client.setConnectTimeout(2000);
+    QCOMPARE(client.connectAttemptDelay(), 50);
+    QCOMPARE(client.connectTimeout(), 2000);
+    QVERIFY(client.setOption(Socket::LowDelayOption, true));
+    QVERIFY(client.connect(QStringLiteral("localhost"), port));
+    QCOMPARE(client.state(), Socket::ConnectedState);
+    QCOMPARE(client.peerPort(), port);
+    QVERIFY(client.option(Socket::LowDelayOption).toInt() != 0);
+    QScopedPointer<Socket> request(server.accept());
+    QVERIFY(!request.isNull());
+    QCOMPARE(client.sendall(QByteArray("hello")), qint64(5));
+    QCOMPARE(request->recvall(5), QByteArray("hello"));
+
+    server.close();
+    Socket refused;
+    QVERIFY(!refused.connect(QStringLiteral("localhost"), port));
+    QCOMPARE(refused.error(), Socket::ConnectionRefusedError);
+
+#ifdef Q_OS_LINUX
+    // the queue of backlog 0 is full after one connection, the later connections hang in SYN_SENT.
+    Socket full(Socket::IPv4Protocol);
+    QVERIFY(full.bind(localhost, 0));
+    QVERIFY(full.listen(0));
+    Socket queued;
+    QVERIFY(queued.connect(localhost, full.localPort()));
+    Socket timedOut;
+    timedOut.setConnectTimeout(100);
+    QVERIFY(!timedOut.connect(QStringLiteral("127.0.0.1"), full.localPort()));
+    QCOMPARE(timedOut.error(), Socket::SocketTimeoutError);
+
+    // the Timeout of caller is not taken as the connect timeout.
+    Socket hanging;
+    hanging.setConnectTimeout(5000);
+    bool caught = false;
+    try {
+        Timeout out(100);
+        hanging.connect(QStringLiteral("127.0.0.1"), full.localPort());
+    } catch(TimeoutException &) {
+        caught = true;
+    }
+    QVERIFY(caught);
+#endif
+}
+
+
+void TestCoroutines::testTcpFastOpen()
+{
+    Socket server(Socket::IPv4Protocol);
+    server.setOption(Socket::AddressReusable, true);
+#ifdef Q_OS_LINUX
+    QVERIFY(server.setOption(Socket::TcpFastOpenOption, 16));
+    QVERIFY(server.setOption(Socket::DeferAcceptOption, 1));
+#endif
+    QHostAddress localhost(QHostAddress::LocalHost);
+    QVERIFY(server.bind(localhost, 0));
+    QVERIFY(server.listen(16));
+    quint16 port = server.localPort();
+
+    // the first connection asks for a cookie, the second one may send the data in SYN.
+    const QByteArray data("hello, fast open.");
+    for(int i = 0; i < 2; ++i) {
+        Socket client;
+        QCOMPARE(client.connectAndSend(localhost, port, data), qint64(data.size()));
+        QCOMPARE(client.state(), Socket::ConnectedState);
+        QScopedPointer<Socket> request(server.accept());
+        QVERIFY(!request.isNull());
+        QCOMPARE(request->recvall(data.size()), data);
+    }
+
+    // the server closes every connection, so every request connects again.
+    CoroutineGroup operations;
+    int served = 0;
+    operations.spawn([&server, &served] {
+        while(true) {
+            QSharedPointer<Socket> request(server.accept());
+            if(request.isNull()) {
+                return;
+            }
+            SocketBuffer buf(SocketLike::rawSocket(request));
+            while(true) {
+                const QByteArray &line = buf.readLine(1024);
+                if(line.isEmpty() || line == "\r\n") {
+                    break;
+                }
+            }
+            request->sendall(QByteArray("HTTP/1.1 200 OK\r\nContent-Length: 2\r\nConnection: close\r\n\r\nok"));
+            ++served;
+        }
+    });
+    HttpSession session;
+    session.setTcpFastOpen(true);
+    QVERIFY(session.tcpFastOpen());
+    const QString url = QStringLiteral("http://127.0.0.1:%1/").arg(port);
+    for(int i = 0; i < 2; ++i) {
+        HttpResponse response = session.get(url);
+        QCOMPARE(response.statusCode, 200);
+        QCOMPARE(response.body, QByteArray("ok"));
+    }
+    QCOMPARE(served, 2);
+    server.close();
+
+#ifdef Q_OS_LINUX
+    // the connect timeout applies to the handshake of fast open, see testHappyEyeballs().
+    Socket full(Socket::IPv4Protocol);
+    QVERIFY(full.bind(localhost, 0));
+    QVERIFY(full.listen(0));
+    Socket queued;
+    QVERIFY(queued.connect(localhost, full.localPort()));
+    Socket timedOut;
+    timedOut.setConnectTimeout(100);
+    QCOMPARE(timedOut.connectAndSend(localhost, full.localPort(), data), qint64(-1));
+    QCOMPARE(timedOut.error(), Socket::SocketTimeoutError);
+#endif
+}
+
+
+void TestCoroutines::testIdleConnectionRetry()
+{
+    Socket server(Socket::IPv4Protocol);
+    server.setOption(Socket::AddressReusable, true);
+    QHostAddress localhost(QHostAddress::LocalHost);
+    QVERIFY(server.bind(localhost, 0));
+    QVERIFY(server.listen(16));
+    quint16 port = server.localPort();
+
+    // the server answers the first request of every connection, and closes it after reading the second one.
+    CoroutineGroup operations;
+    QByteArrayList methods;
+    operations.spawn([&server, &methods] {
+        while(true) {
+            QSharedPointer<Socket> request(server.accept());
+            if(request.isNull()) {
+                return;
+            }
+            SocketBuffer buf(SocketLike::rawSocket(request));
+            for(int i = 0; i < 2; ++i) {
+                const QByteArray &firstLine = buf.readLine(1024);
+                if(firstLine.isEmpty()) {
+                    break;
+                }
+                methods.append(firstLine.left(firstLine.indexOf(' ')));
+                while(true) {
+                    const QByteArray &line = buf.readLine(1024);
+                    if(line.isEmpty() || line == "\r\n") {
+                        break;
+                    }
+                }
+                if(i == 0) {
+                    request->sendall(QByteArray("HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok"));
+                }
+            }
+        }
+    });
+    HttpSession session;
+    const QString url = QStringLiteral("http://127.0.0.1:%1/").arg(port);
+    QCOMPARE(session.get(url).statusCode, 200);
+
+    // the POST request may be processed already, it must not be sent again.
+    bool failed = false;
+    try {
+        session.post(url, QByteArray());
+    } catch(RequestException &) {
+        failed = true;
+    }
+    QVERIFY(failed);
+    QCOMPARE(methods.count("POST"), 1);
+
+    QCOMPARE(session.get(url).statusCode, 200);
+    // the idle connection is closed after reading this request, so it is sent again with a new connection.
+    QCOMPARE(session.get(url).statusCode, 200);
+    QCOMPARE(methods, QByteArrayList() << "GET" << "POST" << "GET" << "GET" << "GET");
+    server.close();
+}
+
+
 QTEST_MAIN(TestCoroutines)
 
 #include "test_coroutines.moc"
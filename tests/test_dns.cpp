@@ -0,0 +1,219 @@
+#include <QtTest>
+#include <QtCore/qendian.h>
+#include "qtnetworkng.h"
+
+using namespace qtng;
+
+class TestDns: public QObject
+{
+    Q_OBJECT
+private slots:
+    void testResolve();
+    void testNameError();
+    void testHosts();
+    void testTimeout();
+    void testMismatchedQuestion();
+    void testCallerTimeout();
+    void testDnsCache();
+    void testNegativeCache();
+};
+
+
+// a stand-in dns server, answers `example.test` only.
+struct FakeDnsServer
+{
+    FakeDnsServer()
+        :socket(Socket::IPv4Protocol, Socket::UdpSocket), queries(0), silent(false), wrongQuestion(false)
+    {
+        QHostAddress localhost(QHostAddress::LocalHost);
+        socket.bind(localhost, 0);
+        operations.spawn([this] { serve(); });
+    }
+
+    void serve()
+    {
+        while(socket.isValid()) {
+            QHostAddress addr;
+            quint16 port;
+            const QByteArray &query = socket.recvfrom(512, &addr, &port);
+            if(query.size() < 12 + 5) {
+                continue;
+            }
+            ++queries;
+            ids.append(qFromBigEndian<quint16>(reinterpret_cast<const uchar*>(query.constData())));
+            if(!silent) {
+                QByteArray response = makeResponse(query);
+                if(wrongQuestion) {
+                    response[13] = 'x';
+                }
+                socket.sendto(response, addr, port);
+            }
+        }
+    }
+
+    QByteArray makeResponse(const QByteArray &query)
+    {
+        const QByteArray &qname = query.mid(12, query.size() - 12 - 4);
+        quint16 qtype = qFromBigEndian<quint16>(reinterpret_cast<const uchar*>(query.constData() + query.size() - 4));
+        bool known = (qname == QByteArray("\x07" "example" "\x04" "test" "\x00", 14));
+        QByteArray response = query;
+        uchar *header = reinterpret_cast<uchar*>(response.data());
+        qToBigEndian<quint16>(known ? 0x8180 : 0x8183, header + 2);
+        if(known) {
+            qToBigEndian<quint16>(1, header + 6);
+            uchar fixed[10];
+            qToBigEndian<quint16>(qtype, fixed);
+            qToBigEndian<quint16>(1, fixed + 2);
+            qToBigEndian<quint32>(300, fixed + 4);
+            qToBigEndian<quint16>(qtype == DnsResolver::A ? 4 : 16, fixed + 8);
+            response.append("\xc0\x0c", 2);
+            response.append(reinterpret_cast<const char*>(fixed), 10);
+            if(qtype == DnsResolver::A) {
+                response.append("\x01\x02\x03\x04", 4);
+            } else {
+                Q_IPV6ADDR ip6 = QHostAddress(QStringLiteral("2001:db8::1")).toIPv6Address();
+                response.append(reinterpret_cast<const char*>(ip6.c), 16);
+            }
+        }
+        return response;
+    }
+
+    QSharedPointer<DnsResolver> makeResolver()
+    {
+        QSharedPointer<DnsResolver> resolver(new DnsResolver());
+        QList<QHostAddress> nameServers;
+        nameServers.append(QHostAddress(QHostAddress::LocalHost));
+        resolver->setNameServers(nameServers, socket.localPort());
+        resolver->setSearchDomains(QStringList());
+        resolver->clearHosts();
+        return resolver;
+    }
+
+    Socket socket;
+    CoroutineGroup operations;
+    QList<quint16> ids;
+    int queries;
+    bool silent;
+    bool wrongQuestion;
+};
+
+
+void TestDns::testResolve()
+{
+    FakeDnsServer server;
+    QSharedPointer<DnsResolver> resolver = server.makeResolver();
+    quint32 ttl = 0;
+    const QList<QHostAddress> &addresses = resolver->resolve(QStringLiteral("example.test"), &ttl);
+    QCOMPARE(addresses.size(), 2);
+    QVERIFY(addresses.contains(QHostAddress(QStringLiteral("1.2.3.4"))));
+    QVERIFY(addresses.contains(QHostAddress(QStringLiteral("2001:db8::1"))));
+    QCOMPARE(ttl, quint32(300));
+    QCOMPARE(server.queries, 2);
+}
+
+
+void TestDns::testNameError()
+{
+    FakeDnsServer server;
+    QSharedPointer<DnsResolver> resolver = server.makeResolver();
+    QVERIFY(resolver->query(QStringLiteral("missing.test"), DnsResolver::A).isEmpty());
+    QCOMPARE(server.queries, 1);
+}
+
+
+void TestDns::testHosts()
+{
+    FakeDnsServer server;
+    QSharedPointer<DnsResolver> resolver = server.makeResolver();
+    QTemporaryFile hosts;
+    QVERIFY(hosts.open());
+    hosts.write("# comment line\n10.0.0.1 foo.local foo\n::1 foo.local # another comment\n");
+    hosts.close();
+    QVERIFY(resolver->loadHosts(hosts.fileName()));
+    QCOMPARE(resolver->resolve(QStringLiteral("FOO.local")).size(), 2);
+    QCOMPARE(resolver->query(QStringLiteral("foo"), DnsResolver::A).size(), 1);
+    QCOMPARE(server.queries, 0);
+}
+
+
+void TestDns::testTimeout()
+{
+    FakeDnsServer server;
+    server.silent = true;
+    QSharedPointer<DnsResolver> resolver = server.makeResolver();
+    resolver->setTimeout(100);
+    resolver->setAttempts(2);
+    QElapsedTimer timer;
+    timer.start();
+    QVERIFY(resolver->query(QStringLiteral("example.test"), DnsResolver::A).isEmpty());
+    QVERIFY(timer.elapsed() < 1000);
+    QCOMPARE(server.queries, 2);
+    QVERIFY(server.ids.at(0) != server.ids.at(1));
+}
+
+
+void TestDns::testMismatchedQuestion()
+{
+    FakeDnsServer server;
+    server.wrongQuestion = true;
+    QSharedPointer<DnsResolver> resolver = server.makeResolver();
+    resolver->setTimeout(100);
+    resolver->setAttempts(1);
+    QVERIFY(resolver->query(QStringLiteral("example.test"), DnsResolver::A).isEmpty());
+    QCOMPARE(server.queries, 1);
+}
+
+
+void TestDns::testCallerTimeout()
+{
+    FakeDnsServer server;
+    server.silent = true;
+    QSharedPointer<DnsResolver> resolver = server.makeResolver();
+    resolver->setTimeout(5000);
+    resolver->setAttempts(2);
+    QElapsedTimer timer;
+    timer.start();
+    bool caught = false;
+    try {
+        Timeout out(100);
+        resolver->query(QStringLiteral("example.test"), DnsResolver::A);
+    } catch(TimeoutException &) {
+        caught = true;
+    }
+    QVERIFY(caught);
+    QVERIFY(timer.elapsed() < 1000);
+    QCOMPARE(server.queries, 1);
+}
+
+
+void TestDns::testDnsCache()
+{
+    FakeDnsServer server;
+    SocketDnsCache cache;
+    cache.setResolver(server.makeResolver());
+    QCOMPARE(cache.resolve(QStringLiteral("example.test")).size(), 2);
+    QCOMPARE(cache.resolve(QStringLiteral("example.test")).size(), 2);
+    QCOMPARE(server.queries, 2);
+    QCOMPARE(cache.hits(), quint64(1));
+    QCOMPARE(cache.misses(), quint64(1));
+}
+
+
+void TestDns::testNegativeCache()
+{
+    FakeDnsServer server;
+    SocketDnsCache cache;
+    cache.setResolver(server.makeResolver());
+    cache.setNegativeTtl(1);
+    QVERIFY(cache.resolve(QStringLiteral("missing.test")).isEmpty());
+    QVERIFY(cache.resolve(QStringLiteral("missing.test")).isEmpty());
+    QCOMPARE(server.queries, 2);
+    Coroutine::sleep(1.1);
+    QVERIFY(cache.resolve(QStringLiteral("missing.test")).isEmpty());
+    QCOMPARE(server.queries, 4);
+}
+
+
+//QTEST_MAIN(TestDns)
+
+#include "test_dns.moc"
@@ -11,6 +11,8 @@ private slots:
     void testSimple();
     void testSocks5Proxy();
     void testVersion10();
+    void testSessionResumption();
+    void testKernelTls();
 };
 
 
@@ -65,6 +67,95 @@ void TestSsl::testVersion10()
     QVERIFY(response.version == Http1_0);
 }
 
+void TestSsl::testSessionResumption()
+{
+    PrivateKey key = PrivateKey::generate(PrivateKey::Rsa, 2048);
+    const QDateTime &now = QDateTime::currentDateTime();
+    QMultiMap<Certificate::SubjectInfo, QString> subjectInfoes = {
+        { Certificate::CommonName, QStringLiteral("localhost") },
+    };
+    Certificate cert = Certificate::generate(key, MessageDigest::Sha256, 1, now, now.addDays(1), subjectInfoes);
+    SslConfiguration config;
+    config.setPrivateKey(key);
+    config.setLocalCertificate(cert);
+
+    SslSocket server(Socket::IPv4Protocol, config);
+    QHostAddress localhost(QHostAddress::LocalHost);
+    QVERIFY(server.bind(localhost, 0));
+    QVERIFY(server.listen(16));
+    CoroutineGroup operations;
+    operations.spawn([&server] {
+        while(true) {
+            QSharedPointer<SslSocket> request = server.accept();
+            if(request.isNull()) {
+                return;
+            }
+            request->sendall("hello");
+        }
+    });
+
+    QSharedPointer<SslSessionCache> cache(new SslSessionCache());
+    for(int i = 0; i < 2; ++i) {
+        SslSocket client(Socket::IPv4Protocol);
+        client.setSessionCache(cache);
+        QVERIFY(client.connect(localhost, server.localPort()));
+        QCOMPARE(client.isSessionResumed(), i > 0);
+        QCOMPARE(client.recvall(5), QByteArray("hello"));
+    }
+    QCOMPARE(cache->size(), 1);
+}
+
+void TestSsl::testKernelTls()
+{
+    PrivateKey key = PrivateKey::generate(PrivateKey::Rsa, 2048);
+    const QDateTime &now = QDateTime::currentDateTime();
+    QMultiMap<Certificate::SubjectInfo, QString> subjectInfoes = {
+        { Certificate::CommonName, QStringLiteral("localhost") },
+    };
+    Certificate cert = Certificate::generate(key, MessageDigest::Sha256, 1, now, now.addDays(1), subjectInfoes);
+    SslConfiguration config;
+    config.setPrivateKey(key);
+    config.setLocalCertificate(cert);
+    config.setKernelTlsEnabled(true);
+
+    SslSocket server(Socket::IPv4Protocol, config);
+    QHostAddress localhost(QHostAddress::LocalHost);
+    QVERIFY(server.bind(localhost, 0));
+    QVERIFY(server.listen(16));
+    CoroutineGroup operations;
+    operations.spawn([&server] {
+        QSharedPointer<SslSocket> request = server.accept();
+        if(request.isNull()) {
+            return;
+        }
+        const QByteArray &data = request->recvall(1024 * 64);
+        request->sendall(data);
+    });
+
+    // works whether or not the kernel supports kTLS.
+    SslConfiguration clientConfig;
+    clientConfig.setKernelTlsEnabled(true);
+    SslSocket client(Socket::IPv4Protocol, clientConfig);
+    QVERIFY(client.connect(localhost, server.localPort()));
+    const QByteArray data(1024 * 64, 'x');
+    QCOMPARE(client.sendall(data), qint64(data.size()));
+    QCOMPARE(client.recvall(data.size()), data);
+
+#ifdef Q_OS_LINUX
+    // openssl loads the tls module of kernel by the handshake above, if both of them support kTLS.
+    QFile ulp(QStringLiteral("/proc/sys/net/ipv4/tcp_available_ulp"));
+    if(!ulp.open(QIODevice::ReadOnly) || !ulp.readAll().contains("tls")) {
+        QSKIP("the kernel or openssl does not support kTLS.");
+    }
+    if(!client.cipher().name().contains(QStringLiteral("GCM"))) {
+        QSKIP("the cipher is not supported by kTLS.");
+    }
+    QVERIFY(client.isKernelTlsSendEnabled());
+#else
+    QSKIP("kTLS is supported on Linux only.");
+#endif
+}
+
 //QTEST_MAIN(TestSsl)
 
 #include "test_ssl.moc"